@@ -0,0 +1,192 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : meterbench.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Throughput of the audio meter kernels
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+/*
+	Runs what AudioMetering does per tick - floor the readings of every source, then fold them
+	into each subscriber's held levels - with each instruction set the cpu supports, and checks
+	that they all agree with the scalar kernels. Build with -DUCOBS_BUILD_BENCHMARKS=ON.
+	
+	meterbench [sources] [subscribers] [ticks]
+*/
+
+#include "../src/meterkernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace MeterKernels;
+
+static const int kChannels = 8; ///< MAX_AUDIO_CHANNELS
+static const float kSilenceDb = -96.f;
+
+//************************************************************************************************
+// Levels
+//************************************************************************************************
+
+struct Levels
+{
+	std::vector<float> magnitude;
+	std::vector<float> peak;
+	std::vector<float> inputPeak;
+	
+	void resize (int count, float value)
+	{
+		magnitude.assign (count, value);
+		peak.assign (count, value);
+		inputPeak.assign (count, value);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void randomize (Levels& levels, unsigned int& seed)
+{
+	auto next = [&seed] ()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return float (seed >> 8) / float (1 << 24);
+	};
+	for(size_t i = 0; i < levels.magnitude.size (); i++)
+	{
+		// a few silent channels (-inf, as the volmeter reports them) among the levels
+		bool silent = next () < 0.1f;
+		levels.magnitude[i] = silent ? -std::numeric_limits<float>::infinity () : -60.f * next ();
+		levels.peak[i] = silent ? -std::numeric_limits<float>::infinity () : levels.magnitude[i] + 6.f * next ();
+		levels.inputPeak[i] = levels.peak[i];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double run (const std::vector<Levels>& readings, std::vector<Levels>& held, int ticks, int count)
+{
+	Levels reading;
+	reading.resize (count, 0.f);
+	
+	auto start = std::chrono::steady_clock::now ();
+	for(int tick = 0; tick < ticks; tick++)
+	{
+		const Levels& source = readings[tick % readings.size ()];
+		memcpy (reading.magnitude.data (), source.magnitude.data (), count * sizeof (float));
+		memcpy (reading.peak.data (), source.peak.data (), count * sizeof (float));
+		memcpy (reading.inputPeak.data (), source.inputPeak.data (), count * sizeof (float));
+		floorDb (reading.magnitude.data (), kSilenceDb, count);
+		floorDb (reading.peak.data (), kSilenceDb, count);
+		floorDb (reading.inputPeak.data (), kSilenceDb, count);
+		dbToPower (reading.magnitude.data (), count);
+		
+		for(Levels& subscriber : held)
+		{
+			accumulate (subscriber.magnitude.data (), reading.magnitude.data (), count);
+			holdMax (subscriber.peak.data (), reading.peak.data (), count);
+			holdMax (subscriber.inputPeak.data (), reading.inputPeak.data (), count);
+		}
+	}
+	for(Levels& subscriber : held)
+	{
+		scale (subscriber.magnitude.data (), 1.f / ticks, count);
+		powerToDb (subscriber.magnitude.data (), count);
+		floorDb (subscriber.magnitude.data (), kSilenceDb, count);
+	}
+	
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+	return elapsed.count () / ticks;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char** argv)
+{
+	int sources = argc > 1 ? atoi (argv[1]) : 64;
+	int subscribers = argc > 2 ? atoi (argv[2]) : 4;
+	int ticks = argc > 3 ? atoi (argv[3]) : 200000;
+	if(sources < 1 || subscribers < 1 || ticks < 1)
+	{
+		printf ("usage: meterbench [sources] [subscribers] [ticks]\n");
+		return 1;
+	}
+	
+	int count = sources * kChannels;
+	unsigned int seed = 2021;
+	std::vector<Levels> readings (16);
+	for(Levels& levels : readings)
+	{
+		levels.resize (count, 0.f);
+		randomize (levels, seed);
+	}
+	
+	printf ("%d sources x %d channels, %d subscribers, %d ticks\n", sources, kChannels, subscribers, ticks);
+	
+	std::vector<Levels> reference;
+	double scalarNanos = 0;
+	for(InstructionSet instructionSet : {kScalar, kSSE2, kAVX2})
+	{
+		if(!setInstructionSet (instructionSet))
+		{
+			printf ("%-8s not supported\n", getName (instructionSet));
+			continue;
+		}
+		
+		std::vector<Levels> held (subscribers);
+		for(Levels& levels : held)
+		{
+			levels.resize (count, kSilenceDb);
+			levels.magnitude.assign (count, 0.f);
+		}
+		
+		run (readings, held, ticks / 10 + 1, count); // warm up
+		for(Levels& levels : held)
+		{
+			levels.resize (count, kSilenceDb);
+			levels.magnitude.assign (count, 0.f);
+		}
+		double nanos = run (readings, held, ticks, count);
+		
+		// floats touched per tick: 3 floors, then per subscriber 3 reads + 3 read/writes
+		double bytesPerTick = double (count) * sizeof (float) * (3 * 2 + subscribers * 3 * 3);
+		bool matches = true;
+		if(instructionSet == kScalar)
+		{
+			reference = held;
+			scalarNanos = nanos;
+		}
+		else
+		{
+			for(int i = 0; i < subscribers; i++)
+				for(int j = 0; j < count; j++)
+					if(std::fabs (held[i].magnitude[j] - reference[i].magnitude[j]) > 1e-3f || held[i].peak[j] != reference[i].peak[j] || held[i].inputPeak[j] != reference[i].inputPeak[j])
+						matches = false;
+		}
+		
+		printf ("%-8s %9.1f ns/tick  %6.2f GB/s  x%.2f  %s\n", getName (instructionSet), nanos, bytesPerTick / nanos,
+				scalarNanos / nanos, matches ? "" : "MISMATCH");
+		if(!matches)
+			return 2;
+	}
+	return 0;
+}
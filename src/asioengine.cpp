@@ -0,0 +1,528 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : asioengine.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Standalone asio network engine, running on its own I/O thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#define ENABLE_LOGGING 1
+#include "common.h"
+
+#include "asioengine.h"
+#include "networkconnection.h"
+
+#include <asio.hpp>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "moc_asioengine.cpp"
+
+using asio::ip::tcp;
+
+//************************************************************************************************
+// AsioSession
+//************************************************************************************************
+
+class AsioSession : public std::enable_shared_from_this<AsioSession>
+{
+public:
+	static const int kReadChunkBytes = 16384;
+	static const int kMaxInboundMessages = 1024; ///< reading pauses while this many are waiting for the Qt thread
+
+	AsioSession (tcp::socket socket, qint64 maxFrameSize);
+	~AsioSession ();
+
+	void start ();
+	void shutdown ();
+	void write (const QByteArray& data);
+
+	// Qt thread:
+	void attach (AsioSessionDevice* device);
+	void detach ();
+	void clearNotify ();
+	bool takeMessages (QVector<QJsonObject>& messages); ///< false once the stream was malformed or the session is closed
+	NetworkFraming getFraming () const;
+	qint64 bytesToWrite () const;
+
+protected:
+	// I/O thread:
+	void doRead ();
+	void doWrite ();
+	void closed ();
+	void notifyReadyRead ();
+	void notifyClosed ();
+
+	tcp::socket socket;
+	FrameParser parser; ///< frames are split and their json decoded here, on the I/O thread
+	QVector<QJsonObject> decoded; ///< by the last read
+	std::deque<QByteArray> writeQueue;
+
+	mutable std::mutex lock; ///< guards everything below, shared between the I/O and Qt threads
+	AsioSessionDevice* device;
+	QVector<QJsonObject> inbound; ///< decoded, waiting for the Qt thread
+	NetworkFraming framing; ///< of the parser, see FrameParser::getFraming ()
+	qint64 pendingWriteBytes;
+	bool malformed; ///< the client sent something the parser rejected, nothing is read after it
+	bool readPaused;
+	bool notifyPending;
+	bool isClosed;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+AsioSession::AsioSession (tcp::socket _socket, qint64 maxFrameSize)
+: socket (std::move (_socket)),
+  device (nullptr),
+  framing (kLegacyFraming),
+  pendingWriteBytes (0),
+  malformed (false),
+  readPaused (false),
+  notifyPending (false),
+  isClosed (false)
+{
+	parser.setMaxFrameSize (maxFrameSize);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+AsioSession::~AsioSession ()
+{
+	std::error_code error;
+	socket.close (error);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::start ()
+{
+	doRead ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::shutdown ()
+{
+	auto self = shared_from_this ();
+	asio::post (socket.get_executor (), [self] ()
+	{
+		std::error_code error;
+		self->socket.shutdown (tcp::socket::shutdown_both, error);
+		self->socket.close (error);
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::write (const QByteArray& data)
+{
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		if(isClosed)
+			return;
+		pendingWriteBytes += data.size ();
+	}
+
+	auto self = shared_from_this ();
+	asio::post (socket.get_executor (), [self, data] ()
+	{
+		self->writeQueue.push_back (data);
+		if(self->writeQueue.size () == 1)
+			self->doWrite ();
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::doRead ()
+{
+	// straight into the parser's buffer, it's only touched on this thread
+	auto self = shared_from_this ();
+	socket.async_read_some (asio::buffer (parser.prepare (kReadChunkBytes), kReadChunkBytes), [self] (std::error_code error, std::size_t bytesRead)
+	{
+		if(error)
+		{
+			self->closed ();
+			return;
+		}
+
+		self->decoded.clear ();
+		bool valid = self->parser.commit (int (bytesRead), self->decoded);
+		{
+			std::lock_guard<std::mutex> guard (self->lock);
+			self->inbound += self->decoded;
+			self->framing = self->parser.getFraming ();
+			if(!valid)
+				self->malformed = true;
+			if(!self->inbound.isEmpty () || self->malformed)
+				self->notifyReadyRead ();
+			if(self->malformed)
+				return; // the Qt side drops the client
+			
+			// don't queue without bound while the Qt thread is behind, takeMessages () resumes us
+			if(self->inbound.size () >= kMaxInboundMessages)
+			{
+				self->readPaused = true;
+				return;
+			}
+		}
+		self->doRead ();
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::doWrite ()
+{
+	// gather everything queued so far into a single scatter-gather write
+	std::vector<asio::const_buffer> buffers;
+	buffers.reserve (writeQueue.size ());
+	for(const QByteArray& data : writeQueue)
+		buffers.push_back (asio::buffer (data.constData (), size_t (data.size ())));
+	size_t buffersWriting = buffers.size ();
+
+	auto self = shared_from_this ();
+	asio::async_write (socket, buffers, [self, buffersWriting] (std::error_code error, std::size_t bytesWritten)
+	{
+		{
+			std::lock_guard<std::mutex> guard (self->lock);
+			self->pendingWriteBytes -= qint64 (bytesWritten);
+		}
+		self->writeQueue.erase (self->writeQueue.begin (), self->writeQueue.begin () + buffersWriting);
+
+		if(error)
+		{
+			self->closed ();
+			return;
+		}
+		if(!self->writeQueue.empty ())
+			self->doWrite ();
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::closed ()
+{
+	std::error_code error;
+	socket.close (error);
+
+	std::lock_guard<std::mutex> guard (lock);
+	if(isClosed)
+		return;
+	isClosed = true;
+	notifyClosed ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::notifyReadyRead ()
+{
+	// called with the lock held. Only one notification is in flight at a time,
+	// the device drains everything that arrived in the meantime.
+	if(!device || notifyPending)
+		return;
+
+	notifyPending = true;
+	AsioSessionDevice* target = device;
+	QMetaObject::invokeMethod (target, [target] ()
+	{
+		target->session->clearNotify ();
+		emit target->readyRead ();
+	}, Qt::QueuedConnection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::notifyClosed ()
+{
+	// called with the lock held
+	if(!device)
+		return;
+
+	AsioSessionDevice* target = device;
+	QMetaObject::invokeMethod (target, [target] () { target->sessionClosed (); }, Qt::QueuedConnection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::attach (AsioSessionDevice* _device)
+{
+	std::lock_guard<std::mutex> guard (lock);
+	device = _device;
+
+	// anything that arrived before the Qt side was ready
+	if(!inbound.isEmpty () || malformed)
+		notifyReadyRead ();
+	if(isClosed)
+		notifyClosed ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::detach ()
+{
+	std::lock_guard<std::mutex> guard (lock);
+	device = nullptr;
+	isClosed = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSession::clearNotify ()
+{
+	std::lock_guard<std::mutex> guard (lock);
+	notifyPending = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AsioSession::takeMessages (QVector<QJsonObject>& messages)
+{
+	std::lock_guard<std::mutex> guard (lock);
+	messages += inbound;
+	inbound.clear ();
+	
+	if(readPaused && !isClosed)
+	{
+		readPaused = false;
+		auto self = shared_from_this ();
+		asio::post (socket.get_executor (), [self] () { self->doRead (); });
+	}
+	
+	// sessionClosed () may not get through to a server that's polling, this is seen either way
+	return !malformed && !isClosed;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+NetworkFraming AsioSession::getFraming () const
+{
+	std::lock_guard<std::mutex> guard (lock);
+	return framing;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+qint64 AsioSession::bytesToWrite () const
+{
+	std::lock_guard<std::mutex> guard (lock);
+	return pendingWriteBytes;
+}
+
+//************************************************************************************************
+// AsioSessionDevice
+//************************************************************************************************
+
+AsioSessionDevice::AsioSessionDevice (std::shared_ptr<AsioSession> _session)
+: session (std::move (_session))
+{
+	open (QIODevice::ReadWrite | QIODevice::Unbuffered);
+	session->attach (this);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+AsioSessionDevice::~AsioSessionDevice ()
+{
+	session->detach ();
+	session->shutdown ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AsioSessionDevice::takeMessages (QVector<QJsonObject>& messages)
+{
+	return session->takeMessages (messages);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+NetworkFraming AsioSessionDevice::getFraming () const
+{
+	return session->getFraming ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+qint64 AsioSessionDevice::bytesToWrite () const
+{
+	return session->bytesToWrite ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSessionDevice::close ()
+{
+	if(!isOpen ())
+		return;
+
+	session->shutdown ();
+	QIODevice::close (); // emits aboutToClose
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioSessionDevice::sessionClosed ()
+{
+	//LOG ("AsioSessionDevice::sessionClosed")
+	close ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+qint64 AsioSessionDevice::readData (char* data, qint64 maxSize)
+{
+	return 0; // no byte stream, the messages are taken whole, see takeMessages ()
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+qint64 AsioSessionDevice::writeData (const char* data, qint64 maxSize)
+{
+	if(maxSize <= 0)
+		return 0;
+
+	session->write (QByteArray (data, int (maxSize)));
+	return maxSize;
+}
+
+//************************************************************************************************
+// AsioEngine
+//************************************************************************************************
+
+struct AsioEngine::Context
+{
+	asio::io_context io;
+	std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work;
+	tcp::acceptor acceptor;
+
+	Context ()
+	: acceptor (io)
+	{}
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+AsioEngine::AsioEngine (QObject* parent)
+: QObject (parent),
+  context (new Context),
+  maxFrameSize (kDefaultMaxFrameSize),
+  lowDelay (false)
+{}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+AsioEngine::~AsioEngine ()
+{
+	stop ();
+
+	// sessions still referenced by pending handlers go away with the io_context
+	context.reset ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AsioEngine::start (quint16 port)
+{
+	if(isRunning ())
+		return false;
+
+	// one io_context for the engine's lifetime: sessions accepted before a stop () keep their
+	// sockets on it and simply resume when it runs again
+	if(context->io.stopped ())
+		context->io.restart ();
+	context->work.emplace (asio::make_work_guard (context->io));
+
+	std::error_code error;
+	tcp::endpoint endpoint (asio::ip::address_v4::loopback (), port);
+	context->acceptor.open (endpoint.protocol (), error);
+	if(!error)
+		context->acceptor.set_option (tcp::acceptor::reuse_address (true), error);
+	if(!error)
+		context->acceptor.bind (endpoint, error);
+	if(!error)
+		context->acceptor.listen (asio::socket_base::max_listen_connections, error);
+	if(error)
+	{
+		LOG ("AsioEngine failed to listen on localhost, port %d: %s", port, error.message ().c_str ())
+		context->acceptor.close (error);
+		context->work.reset ();
+		return false;
+	}
+
+	doAccept ();
+	thread = std::thread ([this] () { context->io.run (); });
+
+	LOG ("AsioEngine listening on localhost, port %d", port)
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioEngine::stop ()
+{
+	if(!isRunning ())
+		return;
+
+	context->work.reset ();
+	context->io.stop ();
+	thread.join ();
+
+	std::error_code error;
+	context->acceptor.close (error);
+
+	// the context stays alive until we're destroyed, any devices still around can safely post to it
+	// and are serviced again after the next start ()
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AsioEngine::doAccept ()
+{
+	context->acceptor.async_accept ([this] (std::error_code error, tcp::socket socket)
+	{
+		if(error == asio::error::operation_aborted)
+			return;
+
+		if(error)
+		{
+			LOG ("AsioEngine accept failed: %s", error.message ().c_str ())
+		}
+		else
+		{
+			if(lowDelay)
+			{
+				std::error_code optionError;
+				socket.set_option (tcp::no_delay (true), optionError);
+			}
+			
+			auto session = std::make_shared<AsioSession> (std::move (socket), maxFrameSize);
+			session->start ();
+
+			// hand it over to the Qt thread
+			QMetaObject::invokeMethod (this, [this, session] ()
+			{
+				emit sessionAccepted (new AsioSessionDevice (session));
+			}, Qt::QueuedConnection);
+		}
+		doAccept ();
+	});
+}
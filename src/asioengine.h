@@ -0,0 +1,107 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : asioengine.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Standalone asio network engine, running on its own I/O thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include "networkconnection.h"
+
+#include <QtCore/QObject>
+#include <QIODevice>
+#include <QByteArray>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class AsioSession;
+class AsioSessionDevice;
+
+//************************************************************************************************
+// AsioEngine
+//************************************************************************************************
+
+/** Accepts and services client sockets with standalone asio on a dedicated I/O thread, which
+	also splits the frames and decodes their json. Each accepted client is handed to the Qt side
+	as an AsioSessionDevice, so a slow client or a stalled main thread never blocks the other side. */
+class AsioEngine : public QObject
+{
+	Q_OBJECT
+public:
+	static const int kDefaultMaxFrameSize = 1024 * 1024;
+
+	AsioEngine (QObject* parent = nullptr);
+	~AsioEngine ();
+
+	void setMaxFrameSize (qint64 bytes) { maxFrameSize = bytes; } ///< for frames received by sessions accepted after this
+	void setLowDelay (bool state) { lowDelay = state; } ///< TCP_NODELAY for sessions accepted after the next start ()
+	bool start (quint16 port);
+	void stop ();
+	bool isRunning () const { return thread.joinable (); }
+
+signals:
+	void sessionAccepted (AsioSessionDevice* device); ///< emitted on the Qt thread, the receiver takes ownership
+
+protected:
+	struct Context;
+
+	void doAccept ();
+
+	std::unique_ptr<Context> context;
+	std::thread thread;
+	std::atomic<qint64> maxFrameSize;
+	bool lowDelay;
+};
+
+//************************************************************************************************
+// AsioSessionDevice
+//************************************************************************************************
+
+/** Qt-thread end of an asio session. Received messages are decoded and queued by the I/O thread
+	and signalled with readyRead (), see MessageDevice. Writes are queued to the I/O thread and never
+	block. The device closes itself when the client disconnects. */
+class AsioSessionDevice : public QIODevice, public MessageDevice
+{
+	Q_OBJECT
+public:
+	AsioSessionDevice (std::shared_ptr<AsioSession> session);
+	~AsioSessionDevice ();
+
+	// QIODevice
+	bool isSequential () const override { return true; }
+	qint64 bytesToWrite () const override;
+	void close () override;
+	
+	// MessageDevice
+	bool takeMessages (QVector<QJsonObject>& messages) override;
+	NetworkFraming getFraming () const override;
+
+protected:
+	friend class AsioSession;
+	void sessionClosed ();
+
+	// QIODevice
+	qint64 readData (char* data, qint64 maxSize) override;
+	qint64 writeData (const char* data, qint64 maxSize) override;
+
+	std::shared_ptr<AsioSession> session;
+};
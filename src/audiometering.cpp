@@ -0,0 +1,464 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : audiometering.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Streams audio source levels to subscribed clients
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#include "audiometering.h"
+#include "protocoladapter.h"
+#include "obsremoteprotocol.h"
+#include "obsobjects.h"
+#include "meterkernels.h"
+#include "networkconnection.h"
+
+#include <QJsonObject>
+#include <QtEndian>
+#include <string.h>
+
+#include "moc_audiometering.cpp"
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+using namespace OBSRemoteProtocol;
+
+//************************************************************************************************
+// AudioMetering
+//************************************************************************************************
+
+AudioMetering::AudioMetering (ProtocolAdapter& adapter)
+: adapter (adapter),
+  revision (0),
+  synchronizePending (false)
+{
+	connect (&timer, &QTimer::timeout, this, &AudioMetering::publish);
+	clock.start ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+AudioMetering::~AudioMetering ()
+{
+	subscribers.clear ();
+	stop ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::subscribe (NetworkConnection& connection, int intervalMs, const QString& formatName)
+{
+	Format format = kJsonFormat;
+	if(formatName == QLatin1String (kLevelFormatBinary8))
+		format = kBinary8Format;
+	else if(formatName == QLatin1String (kLevelFormatBinary16))
+		format = kBinary16Format;
+	if(format != kJsonFormat && connection.getFraming () != kFramingV2)
+	{
+		LOG ("AudioMetering: binary levels need v2 framing, sending json")
+		format = kJsonFormat;
+	}
+	
+	bool wasIdle = subscribers.isEmpty ();
+	
+	Subscriber& subscriber = subscribers[&connection];
+	subscriber.intervalMs = qMax (kMinIntervalMs, intervalMs);
+	subscriber.nextDueMs = clock.elapsed () + subscriber.intervalMs;
+	subscriber.format = format;
+	subscriber.announcedRevision = -1;
+	resetHeld (subscriber);
+	
+	LOG ("AudioMetering: levels every %d ms (%s)", subscriber.intervalMs, format == kJsonFormat ? "json" : "binary")
+	if(wasIdle)
+		start ();
+	updateTimer ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::unsubscribe (NetworkConnection& connection)
+{
+	removeClient (connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::removeClient (NetworkConnection& connection)
+{
+	if(!subscribers.remove (&connection))
+		return;
+	
+	if(subscribers.isEmpty ())
+		stop ();
+	updateTimer ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::start ()
+{
+	if(signal_handler_t* handler = obs_get_signal_handler ())
+	{
+		signal_handler_connect (handler, "source_create", onSourcesChanged, this);
+		signal_handler_connect (handler, "source_remove", onSourcesChanged, this);
+		signal_handler_connect (handler, "source_destroy", onSourcesChanged, this);
+		signal_handler_connect (handler, "source_rename", onSourcesChanged, this);
+	}
+	synchronize ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::stop ()
+{
+	if(signal_handler_t* handler = obs_get_signal_handler ())
+	{
+		signal_handler_disconnect (handler, "source_create", onSourcesChanged, this);
+		signal_handler_disconnect (handler, "source_remove", onSourcesChanged, this);
+		signal_handler_disconnect (handler, "source_destroy", onSourcesChanged, this);
+		signal_handler_disconnect (handler, "source_rename", onSourcesChanged, this);
+	}
+	
+	for(const Meter& meter : meters)
+		delete meter.meter;
+	meters.clear ();
+	reading.reset (0, 0, 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::updateTimer ()
+{
+	// tick at the fastest rate anyone asked for, clients with slower rates are served every few ticks
+	int intervalMs = 0;
+	for(const Subscriber& subscriber : subscribers)
+		if(intervalMs == 0 || subscriber.intervalMs < intervalMs)
+			intervalMs = subscriber.intervalMs;
+	
+	if(intervalMs == 0)
+		timer.stop ();
+	else if(!timer.isActive () || timer.interval () != intervalMs)
+		timer.start (intervalMs);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::onSourcesChanged (void* param, calldata_t* data)
+{
+	obs_source_t* obsSource = (obs_source_t*)calldata_ptr (data, "source");
+	if(!obsSource || (obs_source_get_output_flags (obsSource) & OBS_SOURCE_AUDIO) == 0)
+		return;
+	
+	reinterpret_cast<AudioMetering*> (param)->scheduleSynchronize ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::scheduleSynchronize ()
+{
+	// OBS signals arrive on any thread, the meters are only touched on ours
+	if(synchronizePending.exchange (true))
+		return;
+	
+	QMetaObject::invokeMethod (this, [this] () { synchronize (); }, Qt::QueuedConnection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::synchronize ()
+{
+	synchronizePending = false;
+	if(subscribers.isEmpty ())
+		return;
+	
+	// collect first, the meters are attached outside of the enumeration
+	auto sourceEnumerator = [] (void* param, obs_source_t* source)->bool
+	{
+		if(obs_source_get_output_flags (source) & OBS_SOURCE_AUDIO)
+			reinterpret_cast<QVector<OBSSource>*> (param)->append (OBSSource (source));
+		return true;
+	};
+	QVector<OBSSource> sources;
+	obs_enum_sources (sourceEnumerator, &sources);
+	
+	QHash<obs_source_t*, Meter> remaining;
+	for(const Meter& meter : meters)
+		remaining.insert (meter.source, meter);
+	
+	QVector<Meter> synchronized;
+	synchronized.reserve (sources.count ());
+	QVector<bool> idInUse (kMaxSourceIds, false);
+	bool namesChanged = false;
+	for(const OBSSource& source : sources)
+	{
+		Meter meter = remaining.take (source);
+		if(!meter.meter)
+		{
+			meter.source = source;
+			meter.meter = new AudioMeter (*source);
+		}
+		else if(meter.id >= 0)
+			idInUse[meter.id] = true;
+		
+		QString name = obs_source_get_name (source);
+		if(name != meter.name)
+		{
+			meter.name = name;
+			namesChanged = true;
+		}
+		synchronized.append (meter);
+	}
+	
+	// new meters get the lowest ids the others don't use
+	int nextId = 0;
+	for(Meter& meter : synchronized)
+	{
+		if(meter.id >= 0)
+			continue;
+		while(nextId < kMaxSourceIds && idInUse[nextId])
+			nextId++;
+		if(nextId == kMaxSourceIds)
+		{
+			LOG ("AudioMetering: out of ids, %s is only sent as json", STR (meter.name))
+			continue;
+		}
+		meter.id = nextId;
+		idInUse[nextId] = true;
+	}
+	
+	for(const Meter& meter : remaining)
+	{
+		LOG ("AudioMetering: %s is gone", STR (meter.name))
+		delete meter.meter;
+	}
+	
+	bool layoutChanged = !remaining.isEmpty () || synchronized.count () != meters.count ();
+	for(int index = 0; !layoutChanged && index < meters.count (); index++)
+		layoutChanged = synchronized[index].source != meters[index].source;
+	meters.swap (synchronized);
+	
+	if(layoutChanged || namesChanged)
+		revision++; // announced to binary subscribers with their next frame
+	
+	// the buffers are indexed like meters, what was held for the old order is dropped
+	if(layoutChanged)
+		for(Subscriber& subscriber : subscribers)
+			resetHeld (subscriber);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::resetHeld (Subscriber& subscriber) const
+{
+	subscriber.held.reset (meters.count (), 0.f, kSilenceDb);
+	subscriber.ticks = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::publish ()
+{
+	qint64 now = clock.elapsed ();
+	qint64 slack = timer.interval () / 2; // don't miss a period because the timer fired a little early
+	
+	// each meter is drained once per tick, no matter how many clients there are
+	int count = meters.count () * MAX_AUDIO_CHANNELS;
+	reading.reset (meters.count (), kSilenceDb, kSilenceDb);
+	for(int index = 0; index < meters.count (); index++)
+	{
+		Meter& meter = meters[index];
+		MeterLevels levels;
+		if(meter.meter->readLevels (levels))
+		{
+			meter.latest = levels;
+			meter.latestMs = now;
+		}
+		if(meter.latestMs >= 0 && now - meter.latestMs <= kHoldLatestMs)
+			reading.set (index, meter.latest);
+	}
+	MeterKernels::floorDb (reading.magnitude.data (), kSilenceDb, count); // -inf (silence) would poison the sums
+	MeterKernels::floorDb (reading.peak.data (), kSilenceDb, count);
+	MeterKernels::floorDb (reading.inputPeak.data (), kSilenceDb, count);
+	MeterKernels::dbToPower (reading.magnitude.data (), count); // magnitudes are averaged as power, not in dB
+	
+	audio_t* audio = obs_get_audio ();
+	int channels = audio ? qBound (1, int (audio_output_get_channels (audio)), MAX_AUDIO_CHANNELS) : 2;
+	for(auto i = subscribers.begin (); i != subscribers.end (); ++i)
+	{
+		Subscriber& subscriber = i.value ();
+		if(subscriber.held.peak.count () != count)
+			resetHeld (subscriber);
+		
+		MeterKernels::accumulate (subscriber.held.magnitude.data (), reading.magnitude.constData (), count);
+		MeterKernels::holdMax (subscriber.held.peak.data (), reading.peak.constData (), count);
+		MeterKernels::holdMax (subscriber.held.inputPeak.data (), reading.inputPeak.constData (), count);
+		subscriber.ticks++;
+		
+		if(subscriber.nextDueMs > now + slack)
+			continue;
+		subscriber.nextDueMs = qMax (subscriber.nextDueMs + subscriber.intervalMs, now + slack);
+		
+		MeterKernels::scale (subscriber.held.magnitude.data (), 1.f / subscriber.ticks, count);
+		MeterKernels::powerToDb (subscriber.held.magnitude.data (), count);
+		MeterKernels::floorDb (subscriber.held.magnitude.data (), kSilenceDb, count);
+		
+		if(subscriber.format == kJsonFormat)
+		{
+			QJsonObject item;
+			item[kValueItemName] = kItemAudioLevels;
+			item[kValueItemValue] = toJson (subscriber.held, channels);
+			item[kValueItemType] = kValueItemTypeSet;
+			adapter.send (item, i.key ());
+		}
+		else
+		{
+			if(subscriber.announcedRevision != revision)
+			{
+				announceSources (*i.key ());
+				subscriber.announcedRevision = revision;
+			}
+			i.key ()->writeFrame (NetworkWriter::encodeMeterFrame (toBinary (subscriber.held, channels, subscriber.format == kBinary16Format, now)));
+		}
+		resetHeld (subscriber);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonArray AudioMetering::toJson (const LevelBuffer& levels, int channels) const
+{
+	auto toJsonDb = [] (float level)
+	{
+		return qRound (level * 10.f) / 10.; // a tenth of a dB is plenty, and keeps the json short
+	};
+	
+	QJsonArray sources;
+	for(int index = 0; index < meters.count (); index++)
+	{
+		int first = index * MAX_AUDIO_CHANNELS;
+		QJsonArray magnitude, peak, inputPeak;
+		for(int channel = first; channel < first + channels; channel++)
+		{
+			magnitude.append (toJsonDb (levels.magnitude[channel]));
+			peak.append (toJsonDb (levels.peak[channel]));
+			inputPeak.append (toJsonDb (levels.inputPeak[channel]));
+		}
+		
+		QJsonObject source;
+		source[kSourceName] = meters[index].name;
+		source[kLevelMagnitude] = magnitude;
+		source[kLevelPeak] = peak;
+		source[kLevelInputPeak] = inputPeak;
+		sources.append (source);
+	}
+	return sources;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray AudioMetering::toBinary (const LevelBuffer& levels, int channels, bool wide, qint64 now) const
+{
+	// levels are floored at kSilenceDb already, anything over 0 dBFS is clipped
+	float range = wide ? 65535.f : 255.f;
+	auto quantize = [range] (float level)
+	{
+		return quint16 ((qMin (level, 0.f) - kSilenceDb) / -kSilenceDb * range + .5f);
+	};
+	
+	int levelBytes = wide ? 2 : 1;
+	QByteArray payload;
+	payload.reserve (kMeterHeaderBytes + meters.count () * (1 + channels * 2 * levelBytes));
+	payload.resize (kMeterHeaderBytes);
+	payload[0] = char (wide ? kMeterFlagWide : 0);
+	payload[1] = char (channels);
+	qToBigEndian<quint32> (quint32 (now), payload.data () + 3); // relative, ms since metering started
+	
+	int sourceCount = 0;
+	for(int index = 0; index < meters.count (); index++)
+	{
+		if(meters[index].id < 0)
+			continue;
+		
+		payload.append (char (meters[index].id));
+		int first = index * MAX_AUDIO_CHANNELS;
+		for(int channel = first; channel < first + channels; channel++)
+		{
+			for(float level : {levels.magnitude[channel], levels.peak[channel]})
+			{
+				quint16 value = quantize (level);
+				if(wide)
+					payload.append (char (value >> 8));
+				payload.append (char (value & 0xFF));
+			}
+		}
+		sourceCount++;
+	}
+	payload[2] = char (sourceCount);
+	return payload;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::announceSources (NetworkConnection& connection)
+{
+	QJsonArray sources;
+	for(const Meter& meter : meters)
+	{
+		if(meter.id < 0)
+			continue;
+		
+		QJsonObject source;
+		source[kSourceName] = meter.name;
+		source[kAudioSourceId] = meter.id;
+		sources.append (source);
+	}
+	
+	QJsonObject item;
+	item[kValueItemName] = kItemAudioSources;
+	item[kValueItemValue] = sources;
+	item[kValueItemType] = kValueItemTypeSet;
+	
+	// written straight to the connection, so it's on the wire ahead of the frame that uses the ids,
+	// without flushing what the adapter gathered for everyone else
+	QJsonObject message;
+	message[kValuesArray] = QJsonArray {item};
+	connection.writeJson (message);
+}
+
+//************************************************************************************************
+// AudioMetering::LevelBuffer
+//************************************************************************************************
+
+void AudioMetering::LevelBuffer::reset (int meterCount, float magnitudeValue, float peakValue)
+{
+	int count = meterCount * MAX_AUDIO_CHANNELS;
+	magnitude.fill (magnitudeValue, count);
+	peak.fill (peakValue, count);
+	inputPeak.fill (peakValue, count);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AudioMetering::LevelBuffer::set (int index, const MeterLevels& levels)
+{
+	int first = index * MAX_AUDIO_CHANNELS;
+	memcpy (magnitude.data () + first, levels.magnitude, sizeof (levels.magnitude));
+	memcpy (peak.data () + first, levels.peak, sizeof (levels.peak));
+	memcpy (inputPeak.data () + first, levels.inputPeak, sizeof (levels.inputPeak));
+}
@@ -0,0 +1,132 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : audiometering.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Streams audio source levels to subscribed clients
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include "levelqueue.h"
+
+#include <QtCore/QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QJsonArray>
+#include <QByteArray>
+
+#include <atomic>
+
+class ProtocolAdapter;
+class NetworkConnection;
+class AudioMeter;
+
+//************************************************************************************************
+// AudioMetering
+//************************************************************************************************
+
+/** Meters every audio source while at least one client subscribed to the levels, and pushes them
+	to each subscriber at the rate it asked for. The meters are drained once per tick, peaks are
+	held per client until they're sent, so a slower client still sees every transient, and the
+	magnitude it gets is the average power since its last push. */
+class AudioMetering : public QObject
+{
+	Q_OBJECT
+public:
+	AudioMetering (ProtocolAdapter& adapter);
+	~AudioMetering ();
+	
+	static const int kDefaultIntervalMs = 33; ///< ~30 Hz
+	static const int kMinIntervalMs = 15;
+	static constexpr float kSilenceDb = -96.f; ///< levels below are sent as this
+	
+	void subscribe (NetworkConnection& connection, int intervalMs, const QString& format = QString ()); ///< format: see OBSRemoteProtocol::kSubscribeFormat
+	void unsubscribe (NetworkConnection& connection);
+	void removeClient (NetworkConnection& connection);
+	
+	static void onSourcesChanged (void* param, calldata_t* data);
+	
+protected slots:
+	void publish ();
+	
+protected:
+	static const int kMaxSourceIds = 255; ///< ids fit in a byte of the binary frames
+	static const int kHoldLatestMs = 100; ///< how long a meter's latest reading stands in while nothing new comes in (a client may be faster than the meter)
+	
+	/** Levels of all meters as structure-of-arrays, MAX_AUDIO_CHANNELS floats per meter in the order
+		of meters, so a tick is folded into a client's levels with a few MeterKernels calls. */
+	struct LevelBuffer
+	{
+		QVector<float> magnitude;
+		QVector<float> peak;
+		QVector<float> inputPeak;
+		
+		void reset (int meterCount, float magnitudeValue, float peakValue);
+		void set (int index, const MeterLevels& levels);
+	};
+	
+	enum Format
+	{
+		kJsonFormat = 0,
+		kBinary8Format,
+		kBinary16Format
+	};
+	
+	struct Meter
+	{
+		obs_source_t* source = nullptr; ///< only to tell them apart, never called
+		AudioMeter* meter = nullptr;
+		QString name;
+		int id = -1; ///< in the binary frames, -1 if we ran out of them
+		MeterLevels latest; ///< what was read on the last tick that had anything
+		qint64 latestMs = -1; ///< when
+	};
+	
+	struct Subscriber
+	{
+		int intervalMs = kDefaultIntervalMs;
+		qint64 nextDueMs = 0;
+		LevelBuffer held; ///< since the last push: magnitudes summed up as power over the ticks, peaks held
+		int ticks = 0;
+		Format format = kJsonFormat;
+		int announcedRevision = -1; ///< binary formats: the revision the client last got the source ids for
+	};
+	
+	void start ();
+	void stop ();
+	void updateTimer ();
+	void scheduleSynchronize ();
+	void synchronize (); ///< meters the sources OBS has now, and drops the ones that are gone
+	void resetHeld (Subscriber& subscriber) const;
+	QJsonArray toJson (const LevelBuffer& levels, int channels) const;
+	QByteArray toBinary (const LevelBuffer& levels, int channels, bool wide, qint64 now) const; ///< see OBSRemoteProtocol::kFrameMagicMeters
+	void announceSources (NetworkConnection& connection);
+	
+	ProtocolAdapter& adapter;
+	QVector<Meter> meters;
+	LevelBuffer reading; ///< the current tick's, floored at kSilenceDb, magnitudes as power
+	int revision; ///< bumped whenever the meters' ids or names change
+	QHash<NetworkConnection*, Subscriber> subscribers;
+	QTimer timer;
+	QElapsedTimer clock;
+	std::atomic<bool> synchronizePending;
+};
@@ -0,0 +1,92 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : debouncer.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Collapses bursts of triggers into one notification
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "debouncer.h"
+
+#include "moc_debouncer.cpp"
+
+//************************************************************************************************
+// Debouncer
+//************************************************************************************************
+
+Debouncer::Debouncer (QObject* parent)
+: QObject (parent),
+  quietMs (kDefaultQuietMs),
+  maxLatencyMs (kDefaultMaxLatencyMs)
+{
+	timer.setSingleShot (true);
+	connect (&timer, &QTimer::timeout, this, &Debouncer::expired);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Debouncer::setQuietPeriod (int milliseconds)
+{
+	quietMs = qMax (0, milliseconds);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Debouncer::setMaxLatency (int milliseconds)
+{
+	maxLatencyMs = qMax (0, milliseconds);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Debouncer::trigger ()
+{
+	if(!timer.isActive ())
+		startBurst ();
+	
+	// push the deadline out by the quiet period, but not past the max latency of the burst
+	qint64 remaining = qMax<qint64> (0, qint64 (qMax (quietMs, maxLatencyMs)) - getBurstElapsed ());
+	timer.start (int (qMin<qint64> (quietMs, remaining)));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Debouncer::flush ()
+{
+	if(timer.isActive ())
+		expired ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Debouncer::cancel ()
+{
+	timer.stop ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Debouncer::expired ()
+{
+	LOG ("Debouncer fired after %d ms", int (getBurstElapsed ()))
+	timer.stop ();
+	emit fired ();
+}
@@ -0,0 +1,70 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : debouncer.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Collapses bursts of triggers into one notification
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <QtCore/QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+//************************************************************************************************
+// Debouncer
+//************************************************************************************************
+
+/** Collapses a burst of trigger () calls into a single fired () signal. fired () is emitted once
+	nothing has been triggered for the quiet period, but never later than the max latency after
+	the first trigger of the burst. */
+class Debouncer : public QObject
+{
+	Q_OBJECT
+public:
+	Debouncer (QObject* parent = nullptr);
+	
+	static const int kDefaultQuietMs = 20;
+	static const int kDefaultMaxLatencyMs = 100;
+	
+	void setQuietPeriod (int milliseconds);
+	void setMaxLatency (int milliseconds);
+	int getQuietPeriod () const { return quietMs; }
+	int getMaxLatency () const { return maxLatencyMs; }
+	
+	void trigger ();
+	bool isPending () const { return timer.isActive (); }
+	void flush (); ///< fires now if anything is pending
+	void cancel ();
+	
+signals:
+	void fired ();
+	
+protected slots:
+	void expired ();
+	
+protected:
+	virtual void startBurst () { burst.start (); }
+	virtual qint64 getBurstElapsed () const { return burst.elapsed (); } ///< milliseconds since the first trigger of the burst
+	
+	QTimer timer;
+	QElapsedTimer burst; ///< started with the first trigger of a burst
+	int quietMs;
+	int maxLatencyMs;
+};
@@ -26,6 +26,8 @@
 #define ENABLE_LOGGING 0
 #include "common.h"
 
+#include <algorithm>
+
 //************************************************************************************************
 // Enumerators
 //************************************************************************************************
@@ -167,6 +169,65 @@ namespace Enumerators
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 
+	auto sceneItemPointerEnumerator = [] (obs_scene* obsScene, obs_sceneitem_t* obsSceneItem, void* array)->bool
+	{
+		if(!obsScene)
+			return false;
+		QVector<obs_sceneitem_t*>* sceneItemsArray = reinterpret_cast<QVector<obs_sceneitem_t*>*> (array);
+		if(!sceneItemsArray)
+			return false;
+		sceneItemsArray->append (obsSceneItem);
+		
+		return true;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+
+	void enumerateSceneItems (QVector<obs_sceneitem_t*>& sceneItems, const Scene& scene)
+	{
+		// OBS enumerates bottom first
+		obs_scene_enum_items (scene.getInternalScene (), sceneItemPointerEnumerator, &sceneItems);
+		std::reverse (sceneItems.begin (), sceneItems.end ());
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+
+	struct SceneItemsBelow
+	{
+		QVector<obs_sceneitem_t*>& sceneItems;
+		const obs_sceneitem_t* sceneItem;
+		bool found;
+	};
+
+	auto sceneItemsBelowEnumerator = [] (obs_scene* obsScene, obs_sceneitem_t* obsSceneItem, void* param)->bool
+	{
+		if(!obsScene)
+			return false;
+		SceneItemsBelow* below = reinterpret_cast<SceneItemsBelow*> (param);
+		if(!below)
+			return false;
+		if(obsSceneItem == below->sceneItem)
+		{
+			below->found = true;
+			return false;
+		}
+		below->sceneItems.append (obsSceneItem);
+		
+		return true;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+
+	bool enumerateSceneItemsBelow (QVector<obs_sceneitem_t*>& sceneItems, const Scene& scene, const obs_sceneitem_t* sceneItem)
+	{
+		// OBS enumerates bottom first, so stopping at the item leaves those below it
+		SceneItemsBelow below {sceneItems, sceneItem, false};
+		obs_scene_enum_items (scene.getInternalScene (), sceneItemsBelowEnumerator, &below);
+		return below.found;
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+
 	void destroy (QVector<SceneSource*>& sceneSources)
 	{
 		//LOG ("enumerateSceneSources -")
@@ -45,6 +45,8 @@ namespace Enumerators
 	};
 
 	void enumerateSceneSources (QVector<SceneSource*>& sceneSources, Scene& scene);
+	void enumerateSceneItems (QVector<obs_sceneitem_t*>& sceneItems, const Scene& scene); ///< no wrappers, in the same order (top first)
+	bool enumerateSceneItemsBelow (QVector<obs_sceneitem_t*>& sceneItems, const Scene& scene, const obs_sceneitem_t* sceneItem); ///< no wrappers, bottom first, false if the item isn't in the scene (anymore)
 	void destroy (QVector<SceneSource*>& sceneSources);
 	
 	///< Convenience auto-release enumerator
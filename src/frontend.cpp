@@ -22,7 +22,6 @@
 //************************************************************************************************
 
 #include "frontend.h"
-#include "enumerators.h"
 #include "obsobjects.h"
 
 #include "moc_frontend.cpp"
@@ -43,13 +42,17 @@ FrontEnd::FrontEnd ()
   previewScene (0),
   currentTransition (0),
   recordingOutput (0),
-  streamingOutput (0)
+  streamingOutput (0),
+  collectionLoading (false),
+  profileLoading (false)
 {
 	auto eventCallback = [](enum obs_frontend_event event, void* handler) 
 	{
 		reinterpret_cast<FrontEnd*> (handler)->handleEvent (event);
 	};
 	obs_frontend_add_event_callback (eventCallback, this);
+	connect (&sceneModel, &SceneModel::sceneRemoved, this, &FrontEnd::sceneRemoved);
+	connect (&sceneModel, &SceneModel::sceneListChanged, this, &FrontEnd::sceneListChanged);
 	rebuildCurrentScene ();
 	rebuildPreviewScene ();
 	rebuildCurrentTransition ();
@@ -58,15 +61,17 @@ FrontEnd::FrontEnd ()
 		connect (spinner, QOverload<int>::of (&QSpinBox::valueChanged), this, [=] () { emit transitionDurationChanged (); });
 	if(QListView* sceneTree = findSceneTree ())
 		if(QAbstractItemModel* model = sceneTree->model ())
-			connect (model, &QAbstractItemModel::rowsMoved, this, [=] () { emit sceneListChanged (); });
+			connect (model, &QAbstractItemModel::rowsMoved, this, [=] () { synchronizeScenes (); });
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 FrontEnd::~FrontEnd ()
 {
-	delete currentScene;
-	delete previewScene;
+	disconnect (&sceneModel, &SceneModel::sceneRemoved, this, &FrontEnd::sceneRemoved);
+	disconnect (&sceneModel, &SceneModel::sceneListChanged, this, &FrontEnd::sceneListChanged);
+	if(currentTransition)
+		sceneModel.removeReceiver (*currentTransition);
 	delete currentTransition;
 	delete recordingOutput;
 	delete streamingOutput;
@@ -83,6 +88,8 @@ void FrontEnd::handleEvent (enum obs_frontend_event event)
 	case OBS_FRONTEND_EVENT_EXIT :
 		{
 			//LOG ("OBS_FRONTEND_EVENT_EXIT");			
+			sceneModel.clear (); // release our scene references before OBS tears them down
+			transitionIndex.clear ();
 			obs_frontend_remove_event_callback ((obs_frontend_event_cb)event, nullptr);
 		} break;
 			
@@ -103,6 +110,8 @@ void FrontEnd::handleEvent (enum obs_frontend_event event)
 		break;
 			
 	case OBS_FRONTEND_EVENT_STUDIO_MODE_ENABLED :
+		if(isBulkLoading ())
+			break;
 		rebuildPreviewScene ();
 		emit studioModeChanged (true);
 		break;
@@ -112,7 +121,7 @@ void FrontEnd::handleEvent (enum obs_frontend_event event)
 		break;		
 			
 	case OBS_FRONTEND_EVENT_PREVIEW_SCENE_CHANGED :
-		if(isStudioMode ())
+		if(isStudioMode () && !isBulkLoading ())
 		{
 			rebuildPreviewScene ();
 			emit previewSceneChanged ();
@@ -120,11 +129,16 @@ void FrontEnd::handleEvent (enum obs_frontend_event event)
 		break;
 			
 	case OBS_FRONTEND_EVENT_TRANSITION_CHANGED :
+		if(isBulkLoading ())
+			break;
 		rebuildCurrentTransition ();
 		emit transitionChanged ();
 		break;
 				
 	case OBS_FRONTEND_EVENT_TRANSITION_LIST_CHANGED :
+		transitionIndex.invalidate ();
+		if(isBulkLoading ())
+			break;
 		emit transitionListChanged ();
 		break;	
 				
@@ -133,14 +147,41 @@ void FrontEnd::handleEvent (enum obs_frontend_event event)
 		break;		
 			
 	case OBS_FRONTEND_EVENT_SCENE_LIST_CHANGED :
-		emit sceneListChanged ();
+		synchronizeScenes ();
 		break;
 			
 	case OBS_FRONTEND_EVENT_SCENE_CHANGED :
 		//LOG ("FrontEnd: OBS_FRONTEND_EVENT_SCENE_CHANGED")
+		if(isBulkLoading ())
+			break;
 		rebuildCurrentScene ();
 		emit sceneChanged ();
 		break;
+	
+	// loading a collection fires a scene list change (and item signals) per scene,
+	// they're held back and the model is rebuilt once it's done
+#if LIBOBS_API_MAJOR_VER >= 27
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGING :
+		collectionLoading = true;
+		beginBulkLoad ();
+		sceneModel.clear (); // the old collection's scenes are about to go, don't keep them (and their inputs) alive
+		break;
+		
+	case OBS_FRONTEND_EVENT_PROFILE_CHANGING :
+		profileLoading = true;
+		beginBulkLoad ();
+		break;
+#endif
+		
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGED :
+		collectionLoading = false;
+		endBulkLoad ();
+		break;
+		
+	case OBS_FRONTEND_EVENT_PROFILE_CHANGED :
+		profileLoading = false;
+		endBulkLoad ();
+		break;
 			
 	default :
 		break;
@@ -149,19 +190,38 @@ void FrontEnd::handleEvent (enum obs_frontend_event event)
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+void FrontEnd::beginBulkLoad ()
+{
+	LOG ("FrontEnd::beginBulkLoad")
+	sceneModel.suspend ();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrontEnd::endBulkLoad ()
+{
+	if(isBulkLoading ()) // the other one is still loading
+		return;
+	
+	// also without a CHANGING before it (older OBS), the model is rebuilt once
+	LOG ("FrontEnd::endBulkLoad")
+	sceneModel.resume ();
+	transitionIndex.invalidate ();
+	rebuildCurrentScene ();
+	rebuildPreviewScene ();
+	rebuildCurrentTransition ();
+	emit bulkLoadFinished ();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
 void FrontEnd::rebuildCurrentScene ()
 {
 	LOG ("FrontEnd::rebuildCurrentScene")
-	if(currentScene)
-	{
-		delete currentScene;
-		currentScene = 0;
-	}
-	
 	AutoReleaseSource obsScene = obs_frontend_get_current_scene ();
-	if(obsScene)
+	currentScene = lookupScene (obsScene);
+	if(currentScene)
 	{
-		currentScene = new Scene (*obsScene);
 		LOG ("currentScene is now %s", STR (currentScene->getName ()))
 	}
 }
@@ -171,18 +231,49 @@ void FrontEnd::rebuildCurrentScene ()
 void FrontEnd::rebuildPreviewScene ()
 {
 	LOG ("FrontEnd::rebuildPreviewScene")
+	AutoReleaseSource obsScene = obs_frontend_get_current_preview_scene ();
+	previewScene = lookupScene (obsScene);
 	if(previewScene)
 	{
-		delete previewScene;
-		previewScene = 0;
+		LOG ("previewScene is now %s", STR (previewScene->getName ()))
 	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+Scene* FrontEnd::lookupScene (obs_source_t* source)
+{
+	if(!source)
+		return nullptr;
 	
-	AutoReleaseSource obsScene = obs_frontend_get_current_preview_scene ();
-	if(obsScene)
+	Scene* scene = sceneModel.findScene (source);
+	if(!scene && !sceneModel.isSuspended () && sceneModel.synchronize ()) // the scene list changed, but we haven't heard about it yet
 	{
-		previewScene = new Scene (*obsScene);
-		LOG ("previewScene is now %s", STR (previewScene->getName ()))
+		scene = sceneModel.findScene (source);
+		emit sceneListChanged ();
 	}
+	return scene;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrontEnd::synchronizeScenes ()
+{
+	if(isBulkLoading ())
+		return;
+	
+	sceneModel.synchronize ();
+	emit sceneListChanged ();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrontEnd::sceneRemoved (Scene& scene)
+{
+	if(currentScene == &scene)
+		currentScene = nullptr;
+	if(previewScene == &scene)
+		previewScene = nullptr;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -191,13 +282,17 @@ void FrontEnd::rebuildCurrentTransition ()
 {
 	if(currentTransition)
 	{
+		sceneModel.removeReceiver (*currentTransition);
 		delete currentTransition;
 		currentTransition = 0;
 	}
 	
 	AutoReleaseSource obsTransition = obs_frontend_get_current_transition ();
 	if(obsTransition)
-		currentTransition = new Transition (*obsTransition);
+	{
+		currentTransition = new Transition (*obsTransition, &sceneModel.getEventQueue ());
+		sceneModel.addReceiver (*currentTransition);
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -211,7 +306,7 @@ Scene* FrontEnd::getCurrentScene () const
 
 void FrontEnd::setCurrentScene (const QString& sceneName)
 {
-	AutoReleaseSource source = obs_get_source_by_name (STR (sceneName)); // increments reference...
+	OBSSource source = findSceneSource (sceneName);
 	if(!source)
 	{
 		LOG ("Warning: setCurrentScene failed: couldn't find scene %s", STR (sceneName))
@@ -233,7 +328,7 @@ Scene* FrontEnd::getPreviewScene () const
 
 void FrontEnd::setPreviewScene (const QString& sceneName)
 {
-	AutoReleaseSource source = obs_get_source_by_name (STR (sceneName)); // increments reference...
+	OBSSource source = findSceneSource (sceneName);
 	if(!source)
 	{
 		LOG ("Warning: setCurrentScene failed: couldn't find scene %s", STR (sceneName))
@@ -246,6 +341,22 @@ void FrontEnd::setPreviewScene (const QString& sceneName)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+OBSSource FrontEnd::findSceneSource (const QString& sceneName)
+{
+	if(Scene* scene = sceneModel.findScene (sceneName))
+		return scene->getInternal ();
+	if(collectionLoading) // what OBS finds now is either being torn down or not set up yet
+		return nullptr;
+	
+	// not in the model yet (or it's suspended), ask OBS, which takes its global source lock
+	AutoReleaseSource source = obs_get_source_by_name (STR (sceneName)); // increments reference...
+	if(!source || obs_source_get_type (source) != OBS_SOURCE_TYPE_SCENE)
+		return nullptr;
+	return OBSSource (source);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
 Transition* FrontEnd::getCurrentTransition () const
 {
 	return currentTransition;
@@ -353,17 +464,13 @@ void FrontEnd::startTransition ()
 
 void FrontEnd::setCurrentTransition (const QString& transitionName)
 {
-	QVector<Transition*> transitions;
-	Enumerators::Transitions other (transitions);
-	for(auto i : transitions)
+	AutoReleaseSource transition = transitionIndex.find (transitionName);
+	if(!transition)
 	{
-		if(i->getName () == transitionName)
-		{
-			obs_frontend_set_current_transition (i->getInternal ());
-			return;
-		}
+		LOG ("Warning: setCurrentTransition: couldn't find transition %s", STR (transitionName))
+		return;
 	}
-	LOG ("Warning: setCurrentTransition: couldn't find transition %s", STR (transitionName))
+	obs_frontend_set_current_transition (transition);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -23,6 +23,9 @@
 
 #pragma once
 
+#include "scenemodel.h"
+#include "transitionindex.h"
+
 #include <obs-frontend-api.h>
 #include <QtCore/QObject>
 #include <QString>
@@ -45,7 +48,10 @@ public:
 	~FrontEnd ();
 	
 	void handleEvent (enum obs_frontend_event event);
+	bool isBulkLoading () const { return collectionLoading || profileLoading; } ///< a scene collection or profile is being loaded
 	
+	const SceneModel& getSceneModel () const { return sceneModel; }
+	SceneModel& getSceneModel () { return sceneModel; }
 	Scene* getCurrentScene () const;
 	void setCurrentScene (const QString& sceneName);
 	Scene* getPreviewScene () const;
@@ -76,17 +82,28 @@ signals:
 	void transitionListChanged ();
 	void transitionStopped ();
 	void transitionDurationChanged ();
+	void bulkLoadFinished (); ///< a scene collection or profile has been loaded, anything may have changed (the signals above are held back while it loads)
 	
 protected:
-	Scene* currentScene;
-	Scene* previewScene;
+	SceneModel sceneModel;
+	TransitionIndex transitionIndex;
+	Scene* currentScene; ///< owned by sceneModel
+	Scene* previewScene; ///< owned by sceneModel
 	Transition* currentTransition;
 	mutable Output* recordingOutput; // need to be mutable because we don't get notified when they change..
 	mutable Output* streamingOutput; // need to be mutable because we don't get notified when they change..
+	bool collectionLoading;
+	bool profileLoading;
 	
+	void beginBulkLoad ();
+	void endBulkLoad ();
 	void rebuildCurrentScene ();
 	void rebuildPreviewScene ();
 	void rebuildCurrentTransition ();
+	Scene* lookupScene (obs_source_t* source);
+	OBSSource findSceneSource (const QString& sceneName);
+	void synchronizeScenes ();
+	void sceneRemoved (Scene& scene);
 	QSpinBox* findTransitionDurationSpinner () const;
 	QListView* findSceneTree () const;
 };
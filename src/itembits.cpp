@@ -0,0 +1,89 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : itembits.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Packed per-item states of scenes of any size
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "itembits.h"
+
+//************************************************************************************************
+// ItemBits
+//************************************************************************************************
+
+ItemBits::ItemBits (int _count)
+: words ((qMax (_count, 0) + kWordBits - 1) / kWordBits, 0),
+  count (qMax (_count, 0))
+{}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ItemBits::isSet (int index) const
+{
+	if(index < 0 || index >= count)
+		return false;
+	return (words[index / kWordBits] >> (index % kWordBits)) & 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBits::set (int index, bool state)
+{
+	if(index < 0 || index >= count)
+		return;
+	quint64 mask = quint64 (1) << (index % kWordBits);
+	if(state)
+		words[index / kWordBits] |= mask;
+	else
+		words[index / kWordBits] &= ~mask;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray ItemBits::toBase64 () const
+{
+	// little-endian bytes, whatever the host's order
+	QByteArray bytes ((count + 7) / 8, 0);
+	for(int i = 0; i < bytes.size (); i++)
+		bytes[i] = char ((words[i / 8] >> ((i % 8) * 8)) & 0xff);
+	return bytes.toBase64 ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ItemBits::fromBase64 (ItemBits& bits, const QByteArray& base64, int count)
+{
+	QByteArray bytes = QByteArray::fromBase64 (base64);
+	if(count < 0)
+		count = bytes.size () * 8;
+	else if(bytes.size () < (count + 7) / 8)
+		return false;
+	
+	bits = ItemBits (count);
+	for(int i = 0; i < (count + 7) / 8; i++)
+		bits.words[i / 8] |= quint64 (quint8 (bytes[i])) << ((i % 8) * 8);
+	
+	// bits past count stay clear, so whole words can be compared
+	if(int tail = count % kWordBits)
+		bits.words.last () &= (quint64 (1) << tail) - 1;
+	return true;
+}
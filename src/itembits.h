@@ -0,0 +1,80 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : itembits.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Packed per-item states of scenes of any size
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+#include <QVector>
+#include <QByteArray>
+
+//************************************************************************************************
+// ItemBits
+//************************************************************************************************
+
+/** One bit per scene source, in source order, packed into 64-bit words so two sets of states
+	are compared a word at a time. On the wire it's base64 of the bytes, item i being bit (i % 8)
+	of byte (i / 8), see OBSRemoteProtocol::kBitsData. */
+class ItemBits
+{
+public:
+	ItemBits (int count = 0); ///< all clear
+	
+	int getCount () const { return count; }
+	bool isSet (int index) const;
+	void set (int index, bool state);
+	
+	QByteArray toBase64 () const;
+	static bool fromBase64 (ItemBits& bits, const QByteArray& base64, int count = -1); ///< count -1: as many as the bytes hold, false if they hold fewer
+	
+	/** Calls f (index, state) for every item whose bit differs from other's, with the state it has
+		in this set. Both must have the same count. */
+	template<typename Function> void forEachDifference (const ItemBits& other, Function f) const;
+	
+protected:
+	static const int kWordBits = 64;
+	
+	QVector<quint64> words;
+	int count;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// ItemBits inline
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename Function> 
+void ItemBits::forEachDifference (const ItemBits& other, Function f) const
+{
+	Q_ASSERT (other.count == count);
+	for(int word = 0; word < words.count (); word++)
+	{
+		quint64 difference = words[word] ^ other.words[word];
+		while(difference)
+		{
+			int bit = qCountTrailingZeroBits (difference);
+			difference &= difference - 1;
+			int index = word * kWordBits + bit;
+			f (index, (words[word] >> bit) & 1);
+		}
+	}
+}
@@ -0,0 +1,102 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : levelqueue.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Lock-free queue carrying audio levels off the audio thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "levelqueue.h"
+
+#include <limits>
+
+//************************************************************************************************
+// MeterLevels
+//************************************************************************************************
+
+MeterLevels::MeterLevels ()
+{
+	const float kSilence = -std::numeric_limits<float>::infinity ();
+	for(int i = 0; i < MAX_AUDIO_CHANNELS; i++)
+	{
+		magnitude[i] = kSilence;
+		peak[i] = kSilence;
+		inputPeak[i] = kSilence;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MeterLevels::hold (const MeterLevels& newer)
+{
+	for(int i = 0; i < MAX_AUDIO_CHANNELS; i++)
+	{
+		magnitude[i] = newer.magnitude[i];
+		peak[i] = qMax (peak[i], newer.peak[i]);
+		inputPeak[i] = qMax (inputPeak[i], newer.inputPeak[i]);
+	}
+}
+
+//************************************************************************************************
+// LevelQueue
+//************************************************************************************************
+
+LevelQueue::LevelQueue ()
+: writeIndex (0),
+  readIndex (0),
+  carryPending (false)
+{
+	static_assert ((kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of 2");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LevelQueue::push (const MeterLevels& levels)
+{
+	if(carryPending)
+		carry.hold (levels);
+	else
+		carry = levels;
+	
+	quint32 write = writeIndex.load (std::memory_order_relaxed);
+	if(write - readIndex.load (std::memory_order_acquire) == kCapacity)
+	{
+		carryPending = true; // full, try again with the next reading
+		return;
+	}
+	
+	ring[write & (kCapacity - 1)] = carry;
+	writeIndex.store (write + 1, std::memory_order_release);
+	carryPending = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool LevelQueue::pop (MeterLevels& levels)
+{
+	quint32 read = readIndex.load (std::memory_order_relaxed);
+	if(read == writeIndex.load (std::memory_order_acquire))
+		return false;
+	
+	levels = ring[read & (kCapacity - 1)];
+	readIndex.store (read + 1, std::memory_order_release);
+	return true;
+}
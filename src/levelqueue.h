@@ -0,0 +1,73 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : levelqueue.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Lock-free queue carrying audio levels off the audio thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <obs-module.h>
+#include <QtGlobal>
+
+#include <atomic>
+
+//************************************************************************************************
+// MeterLevels
+//************************************************************************************************
+
+/** One volume meter reading, in dBFS per channel (-inf for silence), as delivered by obs_volmeter. */
+struct MeterLevels
+{
+	MeterLevels (); ///< silence
+	
+	void hold (const MeterLevels& newer); ///< takes the newer magnitude and keeps the higher peaks of both
+	
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float inputPeak[MAX_AUDIO_CHANNELS];
+};
+
+//************************************************************************************************
+// LevelQueue
+//************************************************************************************************
+
+/** Single-producer, single-consumer ring of meter readings. The audio thread pushes without
+	locking or allocating. When the consumer falls behind and the ring is full, readings are
+	folded into one held back by the producer (see MeterLevels::hold ()) and pushed as soon as
+	there's room again (with the next reading), so a transient is delayed but never lost. */
+class LevelQueue
+{
+public:
+	LevelQueue ();
+	
+	static const quint32 kCapacity = 16; ///< a power of 2, well over what arrives between two reads
+	
+	void push (const MeterLevels& levels); ///< producer only
+	bool pop (MeterLevels& levels); ///< consumer only, false if empty
+	
+protected:
+	MeterLevels ring[kCapacity];
+	alignas (64) std::atomic<quint32> writeIndex; ///< written by the producer (kept apart from readIndex, they're on different cores)
+	alignas (64) std::atomic<quint32> readIndex; ///< written by the consumer
+	
+	// producer only:
+	alignas (64) MeterLevels carry; ///< what couldn't be pushed yet
+	bool carryPending;
+};
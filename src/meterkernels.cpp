@@ -0,0 +1,490 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : meterkernels.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Vectorized reductions over audio meter buffers
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#include "meterkernels.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define METER_KERNELS_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+		#define TARGET_SSE2
+		#define TARGET_AVX2
+	#else
+		#define TARGET_SSE2 __attribute__ ((target ("sse2")))
+		#define TARGET_AVX2 __attribute__ ((target ("avx2")))
+	#endif
+#else
+	#define METER_KERNELS_X86 0
+#endif
+
+namespace MeterKernels
+{
+	//************************************************************************************************
+	// Scalar
+	//************************************************************************************************
+	
+	// written as a > b ? a : b, so NaNs come out the same as with _mm_max_ps (a, b)
+	
+	static void holdMaxScalar (float* held, const float* values, int count)
+	{
+		for(int i = 0; i < count; i++)
+			held[i] = values[i] > held[i] ? values[i] : held[i];
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static void accumulateScalar (float* sums, const float* values, int count)
+	{
+		for(int i = 0; i < count; i++)
+			sums[i] += values[i];
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static void scaleScalar (float* values, float factor, int count)
+	{
+		for(int i = 0; i < count; i++)
+			values[i] *= factor;
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static void floorDbScalar (float* values, float floor, int count)
+	{
+		for(int i = 0; i < count; i++)
+			values[i] = values[i] > floor ? values[i] : floor;
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static void dbToPowerScalar (float* values, int count)
+	{
+		for(int i = 0; i < count; i++)
+			values[i] = std::pow (10.f, values[i] * 0.1f);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static void powerToDbScalar (float* values, int count)
+	{
+		for(int i = 0; i < count; i++)
+			values[i] = 10.f * std::log10 (values[i]);
+	}
+	
+#if METER_KERNELS_X86
+	//************************************************************************************************
+	// Polynomials
+	//************************************************************************************************
+	
+	// The vector versions of dbToPower and powerToDb split the float into exponent and mantissa
+	// and approximate the rest with a polynomial, within about 1e-5 dB of the scalar ones.
+	// 10^(dB/10) = 2^(dB * kLog2Of10 / 10): 2^n by building the exponent, 2^f (|f| <= 0.5) by its Taylor series.
+	// 10 * log10 (x) = kDbPerLn * ln (m) + kDbPerOctave * e for x = m * 2^e (m within sqrt 2 of 1),
+	// ln (m) = 2 * atanh (s) for s = (m - 1) / (m + 1), |s| <= 0.172.
+	
+	static const float kLog2Of10 = 3.32192809f;
+	static const float kDbPerLn = 4.34294482f; ///< 10 / ln (10)
+	static const float kDbPerOctave = 3.01029996f; ///< 10 * log10 (2)
+	static const float kExp2Min = -126.f; ///< the smallest normal exponent, about -379 dB
+	static const float kExp2Max = 127.f;
+	static const float kExp2Coefficients[] = {1.f, 0.693147181f, 0.240226507f, 0.0555041087f, 0.00961812911f, 0.00133335581f, 0.000154035304f}; ///< ln (2)^i / i!
+	static const float kAtanhCoefficients[] = {1.f, 1.f / 3, 1.f / 5, 1.f / 7, 1.f / 9};
+#endif
+	
+#if METER_KERNELS_X86
+	//************************************************************************************************
+	// SSE2
+	//************************************************************************************************
+	
+	TARGET_SSE2 static void holdMaxSSE2 (float* held, const float* values, int count)
+	{
+		int i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps (held + i, _mm_max_ps (_mm_loadu_ps (values + i), _mm_loadu_ps (held + i)));
+		holdMaxScalar (held + i, values + i, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_SSE2 static void accumulateSSE2 (float* sums, const float* values, int count)
+	{
+		int i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps (sums + i, _mm_add_ps (_mm_loadu_ps (sums + i), _mm_loadu_ps (values + i)));
+		accumulateScalar (sums + i, values + i, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_SSE2 static void scaleSSE2 (float* values, float factor, int count)
+	{
+		__m128 factors = _mm_set1_ps (factor);
+		int i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps (values + i, _mm_mul_ps (_mm_loadu_ps (values + i), factors));
+		scaleScalar (values + i, factor, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_SSE2 static void floorDbSSE2 (float* values, float floor, int count)
+	{
+		__m128 floors = _mm_set1_ps (floor);
+		int i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps (values + i, _mm_max_ps (_mm_loadu_ps (values + i), floors));
+		floorDbScalar (values + i, floor, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_SSE2 static inline __m128 dbToPowerSSE2 (__m128 db)
+	{
+		// NaN becomes kExp2Min, _mm_max_ps returns the second operand then
+		__m128 t = _mm_mul_ps (db, _mm_set1_ps (kLog2Of10 * 0.1f));
+		t = _mm_min_ps (_mm_max_ps (t, _mm_set1_ps (kExp2Min)), _mm_set1_ps (kExp2Max));
+		__m128i n = _mm_cvtps_epi32 (t); // rounded to nearest
+		__m128 f = _mm_sub_ps (t, _mm_cvtepi32_ps (n));
+		
+		__m128 p = _mm_set1_ps (kExp2Coefficients[6]);
+		for(int i = 5; i >= 0; i--)
+			p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (kExp2Coefficients[i]));
+		__m128 scale = _mm_castsi128_ps (_mm_slli_epi32 (_mm_add_epi32 (n, _mm_set1_epi32 (127)), 23));
+		return _mm_mul_ps (p, scale);
+	}
+	
+	TARGET_SSE2 static void dbToPowerSSE2 (float* values, int count)
+	{
+		int i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps (values + i, dbToPowerSSE2 (_mm_loadu_ps (values + i)));
+		dbToPowerScalar (values + i, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_SSE2 static inline __m128 powerToDbSSE2 (__m128 x)
+	{
+		// denormals come out far below any meter's floor, 0 and less (and NaN) become -inf
+		__m128i bits = _mm_castps_si128 (x);
+		__m128i e = _mm_sub_epi32 (_mm_srli_epi32 (bits, 23), _mm_set1_epi32 (127));
+		__m128 m = _mm_castsi128_ps (_mm_or_si128 (_mm_and_si128 (bits, _mm_set1_epi32 (0x007fffff)), _mm_set1_epi32 (0x3f800000)));
+		__m128 above = _mm_cmpgt_ps (m, _mm_set1_ps (1.41421356f));
+		m = _mm_sub_ps (m, _mm_and_ps (above, _mm_mul_ps (m, _mm_set1_ps (0.5f))));
+		e = _mm_sub_epi32 (e, _mm_castps_si128 (above)); // the mask is -1
+		
+		__m128 one = _mm_set1_ps (1.f);
+		__m128 s = _mm_div_ps (_mm_sub_ps (m, one), _mm_add_ps (m, one));
+		__m128 s2 = _mm_mul_ps (s, s);
+		__m128 p = _mm_set1_ps (kAtanhCoefficients[4]);
+		for(int i = 3; i >= 0; i--)
+			p = _mm_add_ps (_mm_mul_ps (p, s2), _mm_set1_ps (kAtanhCoefficients[i]));
+		__m128 db = _mm_add_ps (_mm_mul_ps (_mm_mul_ps (p, s), _mm_set1_ps (2 * kDbPerLn)), _mm_mul_ps (_mm_cvtepi32_ps (e), _mm_set1_ps (kDbPerOctave)));
+		
+		__m128 valid = _mm_cmpgt_ps (x, _mm_setzero_ps ());
+		return _mm_or_ps (_mm_and_ps (valid, db), _mm_andnot_ps (valid, _mm_set1_ps (-std::numeric_limits<float>::infinity ())));
+	}
+	
+	TARGET_SSE2 static void powerToDbSSE2 (float* values, int count)
+	{
+		int i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps (values + i, powerToDbSSE2 (_mm_loadu_ps (values + i)));
+		powerToDbScalar (values + i, count - i);
+	}
+	
+	//************************************************************************************************
+	// AVX2
+	//************************************************************************************************
+	
+	TARGET_AVX2 static void holdMaxAVX2 (float* held, const float* values, int count)
+	{
+		int i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps (held + i, _mm256_max_ps (_mm256_loadu_ps (values + i), _mm256_loadu_ps (held + i)));
+		holdMaxScalar (held + i, values + i, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_AVX2 static void accumulateAVX2 (float* sums, const float* values, int count)
+	{
+		int i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps (sums + i, _mm256_add_ps (_mm256_loadu_ps (sums + i), _mm256_loadu_ps (values + i)));
+		accumulateScalar (sums + i, values + i, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_AVX2 static void scaleAVX2 (float* values, float factor, int count)
+	{
+		__m256 factors = _mm256_set1_ps (factor);
+		int i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps (values + i, _mm256_mul_ps (_mm256_loadu_ps (values + i), factors));
+		scaleScalar (values + i, factor, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_AVX2 static void floorDbAVX2 (float* values, float floor, int count)
+	{
+		__m256 floors = _mm256_set1_ps (floor);
+		int i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps (values + i, _mm256_max_ps (_mm256_loadu_ps (values + i), floors));
+		floorDbScalar (values + i, floor, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_AVX2 static inline __m256 dbToPowerAVX2 (__m256 db)
+	{
+		// the same as dbToPowerSSE2 (), 8 at a time
+		__m256 t = _mm256_mul_ps (db, _mm256_set1_ps (kLog2Of10 * 0.1f));
+		t = _mm256_min_ps (_mm256_max_ps (t, _mm256_set1_ps (kExp2Min)), _mm256_set1_ps (kExp2Max));
+		__m256i n = _mm256_cvtps_epi32 (t);
+		__m256 f = _mm256_sub_ps (t, _mm256_cvtepi32_ps (n));
+		
+		__m256 p = _mm256_set1_ps (kExp2Coefficients[6]);
+		for(int i = 5; i >= 0; i--)
+			p = _mm256_add_ps (_mm256_mul_ps (p, f), _mm256_set1_ps (kExp2Coefficients[i]));
+		__m256 scale = _mm256_castsi256_ps (_mm256_slli_epi32 (_mm256_add_epi32 (n, _mm256_set1_epi32 (127)), 23));
+		return _mm256_mul_ps (p, scale);
+	}
+	
+	TARGET_AVX2 static void dbToPowerAVX2 (float* values, int count)
+	{
+		int i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps (values + i, dbToPowerAVX2 (_mm256_loadu_ps (values + i)));
+		dbToPowerScalar (values + i, count - i);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	TARGET_AVX2 static inline __m256 powerToDbAVX2 (__m256 x)
+	{
+		// the same as powerToDbSSE2 (), 8 at a time
+		__m256i bits = _mm256_castps_si256 (x);
+		__m256i e = _mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23), _mm256_set1_epi32 (127));
+		__m256 m = _mm256_castsi256_ps (_mm256_or_si256 (_mm256_and_si256 (bits, _mm256_set1_epi32 (0x007fffff)), _mm256_set1_epi32 (0x3f800000)));
+		__m256 above = _mm256_cmp_ps (m, _mm256_set1_ps (1.41421356f), _CMP_GT_OQ);
+		m = _mm256_sub_ps (m, _mm256_and_ps (above, _mm256_mul_ps (m, _mm256_set1_ps (0.5f))));
+		e = _mm256_sub_epi32 (e, _mm256_castps_si256 (above));
+		
+		__m256 one = _mm256_set1_ps (1.f);
+		__m256 s = _mm256_div_ps (_mm256_sub_ps (m, one), _mm256_add_ps (m, one));
+		__m256 s2 = _mm256_mul_ps (s, s);
+		__m256 p = _mm256_set1_ps (kAtanhCoefficients[4]);
+		for(int i = 3; i >= 0; i--)
+			p = _mm256_add_ps (_mm256_mul_ps (p, s2), _mm256_set1_ps (kAtanhCoefficients[i]));
+		__m256 db = _mm256_add_ps (_mm256_mul_ps (_mm256_mul_ps (p, s), _mm256_set1_ps (2 * kDbPerLn)), _mm256_mul_ps (_mm256_cvtepi32_ps (e), _mm256_set1_ps (kDbPerOctave)));
+		
+		__m256 valid = _mm256_cmp_ps (x, _mm256_setzero_ps (), _CMP_GT_OQ);
+		return _mm256_blendv_ps (_mm256_set1_ps (-std::numeric_limits<float>::infinity ()), db, valid);
+	}
+	
+	TARGET_AVX2 static void powerToDbAVX2 (float* values, int count)
+	{
+		int i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps (values + i, powerToDbAVX2 (_mm256_loadu_ps (values + i)));
+		powerToDbScalar (values + i, count - i);
+	}
+#endif
+	
+	//************************************************************************************************
+	// Dispatch
+	//************************************************************************************************
+	
+	struct KernelTable
+	{
+		InstructionSet instructionSet;
+		void (*holdMax) (float* held, const float* values, int count);
+		void (*accumulate) (float* sums, const float* values, int count);
+		void (*scale) (float* values, float factor, int count);
+		void (*floorDb) (float* values, float floor, int count);
+		void (*dbToPower) (float* values, int count);
+		void (*powerToDb) (float* values, int count);
+	};
+	
+	static const KernelTable kKernelTables[] =
+	{
+		{kScalar, holdMaxScalar, accumulateScalar, scaleScalar, floorDbScalar, dbToPowerScalar, powerToDbScalar},
+	#if METER_KERNELS_X86
+		{kSSE2, holdMaxSSE2, accumulateSSE2, scaleSSE2, floorDbSSE2, dbToPowerSSE2, powerToDbSSE2},
+		{kAVX2, holdMaxAVX2, accumulateAVX2, scaleAVX2, floorDbAVX2, dbToPowerAVX2, powerToDbAVX2},
+	#endif
+	};
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	bool isSupported (InstructionSet instructionSet)
+	{
+		switch(instructionSet)
+		{
+		case kScalar :
+			return true;
+	#if METER_KERNELS_X86 && defined(_MSC_VER) && !defined(__clang__)
+		case kSSE2 :
+			{
+				int info[4] = {};
+				__cpuid (info, 1);
+				return (info[3] & (1 << 26)) != 0;
+			}
+		case kAVX2 :
+			{
+				int info[4] = {};
+				__cpuid (info, 0);
+				if(info[0] < 7)
+					return false;
+				__cpuid (info, 1);
+				bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv (0) & 6) == 6;
+				if(!osSavesAvx)
+					return false;
+				__cpuidex (info, 7, 0);
+				return (info[1] & (1 << 5)) != 0;
+			}
+	#elif METER_KERNELS_X86
+		case kSSE2 :
+			__builtin_cpu_init ();
+			return __builtin_cpu_supports ("sse2");
+		case kAVX2 :
+			__builtin_cpu_init ();
+			return __builtin_cpu_supports ("avx2");
+	#endif
+		default :
+			return false;
+		}
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static const KernelTable* selectKernels ()
+	{
+		const KernelTable* best = &kKernelTables[0];
+		for(const KernelTable& table : kKernelTables)
+			if(isSupported (table.instructionSet))
+				best = &table;
+		return best;
+	}
+	
+	static std::atomic<const KernelTable*> kernels (nullptr);
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	static const KernelTable& getKernels ()
+	{
+		const KernelTable* table = kernels.load (std::memory_order_acquire);
+		if(!table)
+		{
+			table = selectKernels (); // racing threads pick the same one
+			kernels.store (table, std::memory_order_release);
+		}
+		return *table;
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	void holdMax (float* held, const float* values, int count)
+	{
+		getKernels ().holdMax (held, values, count);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	void accumulate (float* sums, const float* values, int count)
+	{
+		getKernels ().accumulate (sums, values, count);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	void scale (float* values, float factor, int count)
+	{
+		getKernels ().scale (values, factor, count);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	void floorDb (float* values, float floor, int count)
+	{
+		getKernels ().floorDb (values, floor, count);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	void dbToPower (float* values, int count)
+	{
+		getKernels ().dbToPower (values, count);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	void powerToDb (float* values, int count)
+	{
+		getKernels ().powerToDb (values, count);
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	InstructionSet getInstructionSet ()
+	{
+		return getKernels ().instructionSet;
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	bool setInstructionSet (InstructionSet instructionSet)
+	{
+		if(!isSupported (instructionSet))
+			return false;
+		
+		for(const KernelTable& table : kKernelTables)
+			if(table.instructionSet == instructionSet)
+			{
+				kernels.store (&table, std::memory_order_release);
+				return true;
+			}
+		return false;
+	}
+	
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	const char* getName (InstructionSet instructionSet)
+	{
+		switch(instructionSet)
+		{
+		case kSSE2 : return "sse2";
+		case kAVX2 : return "avx2";
+		default : return "scalar";
+		}
+	}
+}
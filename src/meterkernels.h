@@ -0,0 +1,54 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : meterkernels.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Vectorized reductions over audio meter buffers
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+//************************************************************************************************
+// MeterKernels
+//************************************************************************************************
+
+/** The per-tick math of the audio meters, over structure-of-arrays buffers (one float per source
+	and channel, in one contiguous array per quantity). Each kernel has an AVX2, an SSE2 and a
+	scalar version, the best one the cpu supports is picked the first time one is called.
+	No OBS or Qt dependencies, so the benchmark builds without them. */
+namespace MeterKernels
+{
+	enum InstructionSet
+	{
+		kScalar = 0,
+		kSSE2,
+		kAVX2
+	};
+	
+	void holdMax (float* held, const float* values, int count); ///< held = max (held, values), a NaN in values leaves held as it was
+	void accumulate (float* sums, const float* values, int count); ///< sums += values
+	void scale (float* values, float factor, int count); ///< values *= factor
+	void floorDb (float* values, float floor, int count); ///< values below floor, -inf and NaN become floor
+	void dbToPower (float* values, int count); ///< dB to linear power, 10^(dB/10). The vector versions are polynomial (about 2e-6 relative), dB below -379 come out as 10^-37.9
+	void powerToDb (float* values, int count); ///< linear power to dB, 10 * log10 (power), 0 becomes -inf. The vector versions are polynomial (within about 1e-5 dB)
+	
+	InstructionSet getInstructionSet (); ///< the one in use
+	bool isSupported (InstructionSet instructionSet);
+	bool setInstructionSet (InstructionSet instructionSet); ///< for benchmarks, false (and nothing changes) if the cpu doesn't support it
+	const char* getName (InstructionSet instructionSet);
+}
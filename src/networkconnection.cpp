@@ -25,9 +25,12 @@
 #include "common.h"
 
 #include "networkconnection.h"
+#include "obsremoteprotocol.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QTimer>
+#include <QtEndian>
+#include <limits>
 
 #include "moc_networkconnection.cpp"
 
@@ -35,119 +38,252 @@
 // NetworkWriter
 //************************************************************************************************
 
-NetworkWriter::NetworkWriter (QTcpSocket& socket)
-: socket (socket)
+NetworkWriter::NetworkWriter (QIODevice& socket)
+: socket (socket),
+  framing (kLegacyFraming)
 {}
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+void NetworkWriter::setFraming (NetworkFraming _framing)
+{
+	framing = _framing;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray NetworkWriter::encodeFrame (const QByteArray& payload, NetworkFraming framing)
+{
+	qint32 bytesToSend = payload.size ();
+	QByteArray frame;
+	if(framing == kFramingV2)
+	{
+		// v2: magic byte, followed by the # of bytes following as 32-bit big-endian
+		frame.reserve (OBSRemoteProtocol::kNumHeaderBytesV2 + bytesToSend);
+		frame.resize (OBSRemoteProtocol::kNumHeaderBytesV2);
+		frame[0] = char (OBSRemoteProtocol::kFrameMagicV2);
+		qToBigEndian<quint32> (quint32 (bytesToSend), frame.data () + 1);
+	}
+	else
+	{
+		// legacy: a leading 4-byte 'header' (which is just the # of bytes following, as ascii digits)
+		if(bytesToSend > OBSRemoteProtocol::kMaxPayloadBytesLegacy)
+		{
+			LOG ("Warning: NetworkWriter can't frame %d byte message for a legacy client", bytesToSend)
+			return QByteArray ();
+		}
+		frame.reserve (NetworkConnection::kNumHeaderBytes + bytesToSend);
+		frame.append (QByteArray::number (bytesToSend).rightJustified (NetworkConnection::kNumHeaderBytes, '0'));
+	}
+	frame.append (payload);
+	return frame;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray NetworkWriter::encodeMeterFrame (const QByteArray& payload)
+{
+	// same header as v2, only the magic byte differs
+	QByteArray frame;
+	frame.reserve (OBSRemoteProtocol::kNumHeaderBytesV2 + payload.size ());
+	frame.resize (OBSRemoteProtocol::kNumHeaderBytesV2);
+	frame[0] = char (OBSRemoteProtocol::kFrameMagicMeters);
+	qToBigEndian<quint32> (quint32 (payload.size ()), frame.data () + 1);
+	frame.append (payload);
+	return frame;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool NetworkWriter::write (const QJsonObject& json)
 {
 	QByteArray jsonData = QJsonDocument (json).toJson (QJsonDocument::Compact);
-	qint32 bytesToSend = jsonData.size ();
-	if(bytesToSend <= 0)
+	if(jsonData.isEmpty ())
 	{
-		LOG ("Warning: NetworkWriter trying to write %d bytes", bytesToSend)
+		LOG ("Warning: NetworkWriter trying to write 0 bytes")
 		return true;
 	}
 	
-	// we write all data with a leading 4-byte 'header' (which is just the # of bytes following)
-	QString paddedSizeString = QString ("%1").arg (QString::number (bytesToSend), NetworkConnection::kNumHeaderBytes, QChar ('0'));
-	//LOG ("NetworkWriter::write: [%s]:'%s'", STR (paddedSizeString), jsonData.data ())
-	if(socket.write (STR (paddedSizeString)) > 0)
-	{
-		if(socket.write (jsonData) > 0)
-			return true;
-	}
-	return false;
+	QByteArray frame = encodeFrame (jsonData, framing);
+	if(frame.isEmpty ())
+		return false; // refused, see encodeFrame ()
+	
+	//LOG ("NetworkWriter::write: '%s'", frame.constData ())
+	return writeFrame (frame);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkWriter::writeFrame (const QByteArray& frame)
+{
+	// cork: a lone frame is kept as the (shared) buffer it came in, more are gathered behind it
+	if(pending.isEmpty ())
+		pending = frame;
+	else
+		pending.append (frame);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkWriter::flush ()
+{
+	if(pending.isEmpty ())
+		return true;
+	
+	// uncork: header and payload of every queued frame, in one write
+	qint64 bytesWritten = socket.write (pending);
+	bool succeeded = bytesWritten == pending.size ();
+	pending.clear ();
+	return succeeded;
 }
 
 //************************************************************************************************
-// NetworkReader
+// FrameParser
 //************************************************************************************************
 
-NetworkReader::NetworkReader (QTcpSocket& socket)
-: socket (socket),
-  readPos (0),
-  expectingBytes (0),
-  bytesToRead (0)
+FrameParser::FrameParser ()
+: readPos (0),
+  writePos (0),
+  maxFrameSize (kDefaultMaxFrameSize),
+  framing (kLegacyFraming)
 {
-	resetBuffers ();
+	buffer.reserve (NetworkReader::kReadChunkBytes); // reserved capacity survives resize (0), so the buffer is reused
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void NetworkReader::resetBuffers ()
+void FrameParser::setMaxFrameSize (qint64 bytes)
 {
-	readPos = -NetworkConnection::kNumHeaderBytes;
-	expectingBytes = 0;
-	bytesToRead = 0;
-	buffer.clear ();
+	maxFrameSize = qBound<qint64> (0, bytes, std::numeric_limits<int>::max () - OBSRemoteProtocol::kNumHeaderBytesV2);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool NetworkReader::read ()
+char* FrameParser::prepare (int size)
 {
-	while(true)
+	buffer.resize (writePos + size);
+	return buffer.data () + writePos;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool FrameParser::commit (int size, QVector<QJsonObject>& messages)
+{
+	writePos += size;
+	buffer.resize (writePos);
+	return parseFrames (messages);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool FrameParser::parseFrames (QVector<QJsonObject>& messages)
+{
+	while(buffer.size () > readPos)
 	{
-		qint64 bytesAvailable = socket.bytesAvailable ();
-		if(bytesAvailable <= 0)
-			return true;
+		const char* header = buffer.constData () + readPos;
+		int bytesBuffered = buffer.size () - readPos;
+		int headerSize = 0;
+		qint64 frameSize = 0;
 		
-		if(readPos < 0)
+		if(quint8 (header[0]) == OBSRemoteProtocol::kFrameMagicV2)
 		{
-			expectingBytes = 0;
-			bytesToRead = 0;
-			// we're awaiting the "header" (the number of bytes in the following json)
-			QString headerBytes = socket.read (-readPos);
-			if(headerBytes.isEmpty ())
-			{
-				LOG ("No header bytes found")
-				return false;
-			}
-			int offset = NetworkConnection::kNumHeaderBytes + readPos;
-			buffer.insert (offset, headerBytes);
-			readPos += headerBytes.length ();
+			// v2: magic byte, followed by the number of bytes in the following json as 32-bit big-endian
+			headerSize = OBSRemoteProtocol::kNumHeaderBytesV2;
+			if(bytesBuffered < headerSize)
+				break;
+			frameSize = qFromBigEndian<quint32> (header + 1);
+			framing = kFramingV2;
 		}
-		
-		if(readPos >= 0)
+		else
 		{
-			if(expectingBytes <= 0)
-			{
-				// buffer will now contain a string with the # of bytes we need to read
-				bool converted = false;
-				expectingBytes = buffer.toInt (&converted);
-				if(!converted || expectingBytes < 0)
-				{
-					LOG ("Malformed expectant bytes: %s\n", STR (buffer));
-					return false;
-				}
-				bytesToRead = expectingBytes;
-				buffer.clear ();
-			}
-			
-			QString readBytes = socket.read (bytesToRead);
-			bytesToRead -= readBytes.length ();
-			buffer.insert (readPos, readBytes);
-			if(bytesToRead <= 0)
+			// legacy: the "header" is the number of bytes in the following json, as ascii digits
+			headerSize = NetworkConnection::kNumHeaderBytes;
+			if(bytesBuffered < headerSize)
+				break;
+			for(int i = 0; i < headerSize; i++)
 			{
-				// convert to json
-				QJsonParseError parseError;
-				const QJsonDocument jsonDoc = QJsonDocument::fromJson (buffer.toUtf8 (), &parseError);
-				if(parseError.error == QJsonParseError::NoError && jsonDoc.isObject ())
-				{
-					//LOG ("NetworkReader::read: [%s]", STR (buffer))					
-					emit receivedJson (jsonDoc.object ());
-				}				
-				else
+				if(header[i] < '0' || header[i] > '9')
 				{
-					LOG ("Malformed json: %s", STR (buffer))
+					LOG ("Malformed header: %.*s", headerSize, header)
 					return false;
 				}
-				resetBuffers ();
+				frameSize = frameSize * 10 + (header[i] - '0');
 			}
 		}
+		
+		if(frameSize > maxFrameSize)
+		{
+			LOG ("Frame of %lld bytes exceeds the maximum of %lld", frameSize, maxFrameSize)
+			return false;
+		}
+		
+		if(bytesBuffered - headerSize < frameSize)
+			break; // wait for the rest of the payload
+		
+		// hand the payload to the parser in place, without copying it
+		const QByteArray payload = QByteArray::fromRawData (header + headerSize, int (frameSize));
+		QJsonParseError parseError;
+		const QJsonDocument jsonDoc = QJsonDocument::fromJson (payload, &parseError);
+		if(parseError.error != QJsonParseError::NoError || !jsonDoc.isObject ())
+		{
+			LOG ("Malformed json: %.*s", int (frameSize), payload.constData ())
+			return false;
+		}
+		
+		readPos += headerSize + int (frameSize);
+		//LOG ("FrameParser: [%.*s]", int (frameSize), payload.constData ())
+		messages.append (jsonDoc.object ());
+	}
+	
+	// move a partial frame to the front, so the buffer doesn't grow
+	if(readPos > 0)
+	{
+		if(readPos < buffer.size ())
+			buffer.remove (0, readPos);
+		else
+			buffer.resize (0);
+		readPos = 0;
+		writePos = buffer.size ();
+	}
+	return true;
+}
+
+//************************************************************************************************
+// NetworkReader
+//************************************************************************************************
+
+NetworkReader::NetworkReader (QIODevice& socket)
+: socket (socket)
+{}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkReader::read ()
+{
+	while(true)
+	{
+		qint64 bytesAvailable = socket.bytesAvailable ();
+		if(bytesAvailable <= 0)
+			return true;
+		
+		// append in bounded chunks, so an oversized frame is rejected by its header before we buffer it
+		int chunkSize = int (qMin<qint64> (bytesAvailable, kReadChunkBytes));
+		qint64 bytesRead = socket.read (parser.prepare (chunkSize), chunkSize);
+		if(bytesRead < 0)
+		{
+			LOG ("NetworkReader: read failed")
+			return false;
+		}
+		
+		messages.clear ();
+		bool valid = parser.commit (int (bytesRead), messages);
+		for(const QJsonObject& json : messages)
+			emit receivedJson (json);
+		if(!valid)
+			return false;
+		if(bytesRead == 0)
+			return true;
 	}
 	return true;
 }
@@ -157,15 +293,37 @@ bool NetworkReader::read ()
 //************************************************************************************************
 
 NetworkConnection::NetworkConnection (QObject* parent)
+: NetworkConnection (parent, new QTcpSocket)
+{}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+NetworkConnection::NetworkConnection (QObject* parent, QIODevice* _device)
 : QObject (parent),
-  socket (this),
-  reader (socket),
-  writer (socket)
+  socket (qobject_cast<QTcpSocket*> (_device)),
+  device (_device),
+  messageDevice (dynamic_cast<MessageDevice*> (_device)),
+  reader (*_device),
+  writer (*_device),
+  connected (true)
 {
-	connect (&socket, &QTcpSocket::readyRead, this, &NetworkConnection::readData);
-	connect (&socket, &QTcpSocket::disconnected, this, &NetworkConnection::disconnectCompleted);
+	device->setParent (this);
+	
+	connect (device, &QIODevice::readyRead, this, &NetworkConnection::readData);
+	if(socket)
+		connect (socket, &QTcpSocket::disconnected, this, &NetworkConnection::disconnectCompleted);
+	else
+		connect (device, &QIODevice::aboutToClose, this, &NetworkConnection::disconnectCompleted);
 	connect (&reader, &NetworkReader::receivedJson, this, &NetworkConnection::parsedData);
+	connect (&aliveTimer, &QTimer::timeout, this, &NetworkConnection::aliveExpired);
+	connect (&flushTimer, &QTimer::timeout, this, &NetworkConnection::flush);
+	
+	flushTimer.setSingleShot (true);
+	flushTimer.setInterval (0);
 	
+	// a timer that only fires when the client goes quiet, so an idle connection never wakes us up
+	aliveTimer.setSingleShot (true);
+	aliveTimer.setInterval (kAliveMs);
 	aliveTimer.start ();
 }
 
@@ -173,38 +331,76 @@ NetworkConnection::NetworkConnection (QObject* parent)
 
 NetworkConnection::~NetworkConnection ()
 {
-	disconnect (&socket, &QTcpSocket::readyRead, this, &NetworkConnection::readData);
-	disconnect (&socket, &QTcpSocket::disconnected, this, &NetworkConnection::disconnectCompleted);
+	disconnect (device, &QIODevice::readyRead, this, &NetworkConnection::readData);
+	if(socket)
+		disconnect (socket, &QTcpSocket::disconnected, this, &NetworkConnection::disconnectCompleted);
+	else
+		disconnect (device, &QIODevice::aboutToClose, this, &NetworkConnection::disconnectCompleted);
 	disconnect (&reader, &NetworkReader::receivedJson, this, &NetworkConnection::parsedData);
+	disconnect (&aliveTimer, &QTimer::timeout, this, &NetworkConnection::aliveExpired);
+	disconnect (&flushTimer, &QTimer::timeout, this, &NetworkConnection::flush);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool NetworkConnection::idle ()
 {
-	if(!aliveTimer.isValid ())
+	if(!connected)
 		return false;
 	
-	if(aliveTimer.hasExpired (kAliveMs))
+	flush ();
+	
+	// polling fallback only: run the socket synchronously, as the event loop isn't servicing it
+	if(socket)
 	{
-		LOG ("Connection alive expired. Disconnecting!")
-		aliveTimer.invalidate ();
-		terminate ();
-		return false;
+		socket->waitForReadyRead (0);
+		socket->waitForBytesWritten (0);
 	}
+	else
+		readData (); // the device buffers on its own, its readyRead () may not have been delivered
 	
-	// I have to run the sockets synchronously, as the event loop isn't pumped
-	socket.waitForReadyRead (0);
-	socket.waitForBytesWritten (0);
+	return connected;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkConnection::aliveExpired ()
+{
+	if(!connected)
+		return;
 	
-	return true;
+	LOG ("Connection alive expired. Disconnecting!")
+	connected = false;
+	terminate ();
 }
 	
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool NetworkConnection::setDescriptor (qintptr descriptor)
 {
-	return socket.setSocketDescriptor (descriptor);
+	return socket && socket->setSocketDescriptor (descriptor);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkConnection::setLowDelay (bool state)
+{
+	if(socket)
+		socket->setSocketOption (QAbstractSocket::LowDelayOption, state ? 1 : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkConnection::setMaxFrameSize (qint64 bytes)
+{
+	reader.setMaxFrameSize (bytes);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkConnection::setFraming (NetworkFraming framing)
+{
+	writer.setFraming (framing);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -212,6 +408,9 @@ bool NetworkConnection::setDescriptor (qintptr descriptor)
 void NetworkConnection::parsedData (const QJsonObject& json)
 {
 	aliveTimer.start ();
+	NetworkFraming framing = messageDevice ? messageDevice->getFraming () : reader.getFraming ();
+	if(framing == kFramingV2) // a client that sends v2 frames understands them
+		writer.setFraming (kFramingV2);
 	emit receivedJson (json, *this);
 }
 
@@ -219,9 +418,22 @@ void NetworkConnection::parsedData (const QJsonObject& json)
 
 void NetworkConnection::readData ()
 {
-	if(!reader.read ())
+	bool valid = true;
+	if(messageDevice)
 	{
-		aliveTimer.invalidate ();
+		// decoded on the device's own thread already
+		messages.clear ();
+		valid = messageDevice->takeMessages (messages);
+		for(const QJsonObject& json : messages)
+			parsedData (json);
+	}
+	else
+		valid = reader.read ();
+	
+	if(!valid)
+	{
+		connected = false;
+		aliveTimer.stop ();
 		LOG ("NetworkConnection::readData failed")
 		terminate ();
 	}
@@ -231,13 +443,39 @@ void NetworkConnection::readData ()
 
 bool NetworkConnection::writeJson (const QJsonObject& json)
 {
+	if(!connected)
+		return false;
+	
 	if(!writer.write (json))
+		return false;
+	if(!flushTimer.isActive ())
+		flushTimer.start ();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkConnection::writeFrame (const QByteArray& frame)
+{
+	if(!connected)
+		return false;
+	
+	writer.writeFrame (frame);
+	if(!flushTimer.isActive ())
+		flushTimer.start ();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkConnection::flush ()
+{
+	flushTimer.stop ();
+	if(!writer.flush ())
 	{
+		LOG ("NetworkConnection::flush failed, disconnecting")
 		terminate ();
-		LOG ("NetworkConnection::write failed, disconnecting")
-		return false;
 	}
-	return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -254,15 +492,22 @@ bool NetworkConnection::doWriteJson (const QJsonObject& json)
 void NetworkConnection::terminate ()
 {
 	//LOG ("NetworkConnection::terminate")
-	socket.disconnectFromHost ();
+	if(writer.hasPending ())
+		flush ();
+	
+	if(socket)
+		socket->disconnectFromHost ();
+	else
+		device->close ();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void NetworkConnection::disconnectCompleted ()
 {
-	//LOG ("NetworkConnection::disconnectCompleted. Error? %s", STR (socket.errorString ()))
-	aliveTimer.invalidate ();
+	//LOG ("NetworkConnection::disconnectCompleted. Error? %s", STR (device->errorString ()))
+	connected = false;
+	aliveTimer.stop ();
 	emit disconnectedFromClient (*this);
 }
 
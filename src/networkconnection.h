@@ -25,7 +25,44 @@
 
 #include <QtCore/QObject>
 #include <QtNetwork/QTCPSocket>
-#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QTimer>
+#include <QVector>
+
+/** Wire framing of a connection, picked by the client. */
+enum NetworkFraming
+{
+	kLegacyFraming = 0, ///< 4 ascii digits of payload size (payloads up to 9999 bytes)
+	kFramingV2 ///< magic byte + 32-bit big-endian payload size
+};
+
+//************************************************************************************************
+// FrameParser
+//************************************************************************************************
+
+/** Splits the bytes received from a client into frames of either framing and decodes their json.
+	Not bound to a thread or device, see NetworkReader and the asio engine's sessions. */
+class FrameParser
+{
+public:
+	static const int kDefaultMaxFrameSize = 1024 * 1024;
+	
+	FrameParser ();
+	
+	void setMaxFrameSize (qint64 bytes); ///< larger frames are rejected by their header, before they're buffered
+	NetworkFraming getFraming () const { return framing; } ///< kFramingV2 once a v2 frame has been parsed
+	char* prepare (int size); ///< room for size more bytes at the end of the buffer, see commit ()
+	bool commit (int size, QVector<QJsonObject>& messages); ///< size bytes were written to prepare (), appends the messages they complete. False if the stream is malformed
+	
+protected:
+	bool parseFrames (QVector<QJsonObject>& messages);
+	
+	QByteArray buffer; ///< raw bytes received, reused between frames
+	int readPos; ///< start of the first unparsed frame in buffer
+	int writePos; ///< end of the committed bytes in buffer
+	qint64 maxFrameSize;
+	NetworkFraming framing;
+};
 
 //************************************************************************************************
 // NetworkReader
@@ -35,20 +72,37 @@ class NetworkReader: public QObject
 {
 	Q_OBJECT
 public:
-	NetworkReader (QTcpSocket& socket);
+	static const int kReadChunkBytes = 65536;
+	static const int kDefaultMaxFrameSize = FrameParser::kDefaultMaxFrameSize;
+	
+	NetworkReader (QIODevice& socket);
 	
+	void setMaxFrameSize (qint64 bytes) { parser.setMaxFrameSize (bytes); } ///< larger frames are rejected (and the client dropped) before they're buffered
+	NetworkFraming getFraming () const { return parser.getFraming (); } ///< kFramingV2 once the client has sent a v2 frame
 	bool read ();
 
 signals:
 	void receivedJson (const QJsonObject& json);
 	
 protected:
-	void resetBuffers ();
-	int readPos;
-	QTcpSocket& socket;
-	qint64 expectingBytes;
-	qint64 bytesToRead;
-	QString buffer;
+	QIODevice& socket;
+	FrameParser parser;
+	QVector<QJsonObject> messages; ///< decoded by the last read, reused
+};
+
+//************************************************************************************************
+// MessageDevice
+//************************************************************************************************
+
+/** Implemented by devices that deliver whole, already decoded messages (parsed on another
+	thread) instead of bytes for a NetworkReader. They still signal them with readyRead (). */
+class MessageDevice
+{
+public:
+	virtual ~MessageDevice () {}
+	
+	virtual bool takeMessages (QVector<QJsonObject>& messages) = 0; ///< appends what was decoded so far, false if the stream was malformed or has ended
+	virtual NetworkFraming getFraming () const = 0; ///< as FrameParser::getFraming ()
 };
 
 //************************************************************************************************
@@ -58,12 +112,22 @@ protected:
 class NetworkWriter
 {
 public:
-	NetworkWriter (QTcpSocket& socket);
+	NetworkWriter (QIODevice& socket);
+	
+	static QByteArray encodeFrame (const QByteArray& payload, NetworkFraming framing); ///< header + payload, empty if it can't be framed
+	static QByteArray encodeMeterFrame (const QByteArray& payload); ///< binary audio levels, see OBSRemoteProtocol::kFrameMagicMeters
 	
-	bool write (const QJsonObject& json);
+	void setFraming (NetworkFraming framing);
+	NetworkFraming getFraming () const { return framing; }
+	bool write (const QJsonObject& json); ///< false if it can't be framed for the client (see encodeFrame ())
+	bool writeFrame (const QByteArray& frame); ///< queued until flush ()
+	bool flush (); ///< everything queued goes to the socket in a single write
+	bool hasPending () const { return !pending.isEmpty (); }
 	
 protected:
-	QTcpSocket& socket;
+	QIODevice& socket;
+	NetworkFraming framing;
+	QByteArray pending; ///< frames queued since the last flush, back to back
 };
 
 //************************************************************************************************
@@ -78,10 +142,16 @@ public:
 	static const int kNumHeaderBytes = 4; // we always send a 4 byte size string before json payload
 	
 	NetworkConnection (QObject* parent);
+	NetworkConnection (QObject* parent, QIODevice* device); ///< takes ownership of an already connected device
 	~NetworkConnection ();
 	
 	bool setDescriptor (qintptr descriptor);
-	bool writeJson (const QJsonObject& json);
+	void setMaxFrameSize (qint64 bytes);
+	void setLowDelay (bool state); ///< TCP_NODELAY, for Qt sockets
+	void setFraming (NetworkFraming framing); ///< of what we send, until the client sends a v2 frame
+	NetworkFraming getFraming () const { return writer.getFraming (); }
+	bool writeJson (const QJsonObject& json); ///< false if the client is gone, or the message is too large for its framing
+	bool writeFrame (const QByteArray& frame); ///< an already encoded frame, see NetworkWriter::encodeFrame ()
 	bool idle ();
 	
 signals:
@@ -93,14 +163,21 @@ public slots:
 	void parsedData (const QJsonObject& json);
 	void terminate ();
 	void disconnectCompleted ();
+	void aliveExpired ();
+	void flush ();
 	
 protected:
 	bool writeData (const QByteArray& data);
 	bool doWriteJson (const QJsonObject& json);
 	
 private:
-	QTcpSocket socket;
+	QTcpSocket* socket; ///< null unless we own a plain Qt socket
+	QIODevice* device;
+	MessageDevice* messageDevice; ///< device, if it decodes the messages itself (the reader isn't used then)
+	QVector<QJsonObject> messages; ///< taken from messageDevice, reused
 	NetworkReader reader;
 	NetworkWriter writer;
-	QElapsedTimer aliveTimer;
+	QTimer aliveTimer; ///< single-shot, restarted by every message received from the client
+	QTimer flushTimer; ///< zero-interval, so frames queued in the same event loop turn go out together
+	bool connected;
 };
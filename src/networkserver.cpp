@@ -26,19 +26,31 @@
 
 #include "networkserver.h"
 #include "networkconnection.h"
+#if ENABLE_ASIO_ENGINE
+#include "asioengine.h"
+#endif
 
 #include "moc_networkserver.cpp"
 
+#include <QAbstractEventDispatcher>
+#include <QCoreApplication>
+#include <QThread>
+#include <QJsonDocument>
+
 //************************************************************************************************
 // NetworkServer
 //************************************************************************************************
 
 NetworkServer::NetworkServer (QObject* parent)
-: QTcpServer (parent)
+: QTcpServer (parent),
+  ioMode (kEventDriven),
+  engine (kQtEngine),
+  asioEngine (nullptr),
+  maxFrameSize (NetworkReader::kDefaultMaxFrameSize),
+  lowDelay (false)
 {
 	connect (&timer, &QTimer::timeout, this, &NetworkServer::idle);
 	timer.setInterval (kIdleMs);
-	timer.start ();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -50,20 +62,102 @@ NetworkServer::~NetworkServer ()
 	
 	for(auto connection : connections)
 		delete connection;
+	
+#if ENABLE_ASIO_ENGINE
+	delete asioEngine; // after the connections, their devices still refer to its sessions
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::setIOMode (IOMode mode)
+{
+	ioMode = mode;
+	if(isStarted ())
+	{
+		if(ioMode == kPolling)
+			timer.start ();
+		else
+			timer.stop ();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkServer::isStarted () const
+{
+#if ENABLE_ASIO_ENGINE
+	if(asioEngine && asioEngine->isRunning ())
+		return true;
+#endif
+	return isListening ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkServer::deliversEvents (QThread* thread)
+{
+	if(!QAbstractEventDispatcher::instance (thread))
+		return false;
+	
+	// the host's main thread runs the application's event loop (possibly not yet, while plugins load),
+	// any other thread has to be running its own
+	if(QCoreApplication* application = QCoreApplication::instance ())
+		if(thread == application->thread ())
+			return true;
+	return thread->isRunning ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::setEngine (Engine _engine)
+{
+#if ENABLE_ASIO_ENGINE
+	engine = _engine;
+#else
+	if(_engine == kAsioEngine)
+	{
+		LOG ("Asio engine requested, but this build doesn't include it")
+	}
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::setMaxFrameSize (qint64 bytes)
+{
+	maxFrameSize = bytes;
+	for(auto connection : connections)
+		connection->setMaxFrameSize (maxFrameSize);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::setLowDelay (bool state)
+{
+	lowDelay = state;
+	for(auto connection : connections)
+		connection->setLowDelay (lowDelay);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void NetworkServer::idle ()
 {
-	// there's something weird with the event loop in 
-	// these OBS plugs, i need to pump these manually?
+	// polling fallback, for hosts whose event loop doesn't service our socket notifiers:
+	// pump the listening socket and every client manually.
 	bool timedOut = false;
 	if(waitForNewConnection (0, &timedOut))
 	{
 		//LOG ("Server detects new connection.")
 	}
 	
+#if ENABLE_ASIO_ENGINE
+	// the asio engine hands over new sessions with queued calls
+	if(asioEngine)
+		QCoreApplication::sendPostedEvents (asioEngine, QEvent::MetaCall);
+#endif
+	
 	for(auto connection : connections)
 	{
 		if(!connection->idle ())
@@ -71,6 +165,13 @@ void NetworkServer::idle ()
 				deadConnections.append (connection);
 	}
 	
+	purgeDeadConnections ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::purgeDeadConnections ()
+{
 	for(auto connection : deadConnections)
 	{
 		LOG ("Deleting dead connection")
@@ -84,9 +185,41 @@ void NetworkServer::idle ()
 
 void NetworkServer::start (qint16 port)
 {	
+	// checked once, event-driven mode has no timer to catch up with what the event loop doesn't deliver
+	if(ioMode == kEventDriven && !deliversEvents (thread ()))
+	{
+		LOG ("No running event loop on the server thread, falling back to polling")
+		ioMode = kPolling;
+	}
+	
+#if ENABLE_ASIO_ENGINE
+	if(engine == kAsioEngine)
+	{
+		if(!asioEngine)
+		{
+			asioEngine = new AsioEngine;
+			connect (asioEngine, &AsioEngine::sessionAccepted, this, &NetworkServer::sessionAccepted);
+		}
+		asioEngine->setMaxFrameSize (maxFrameSize);
+		asioEngine->setLowDelay (lowDelay);
+		if(asioEngine->start (quint16 (port)))
+		{
+			// sessions hand data over with queued calls, which only the pump delivers when polling
+			if(ioMode == kPolling)
+				timer.start ();
+			return;
+		}
+		
+		LOG ("Falling back to the Qt engine")
+		engine = kQtEngine;
+	}
+#endif
+	
 	if(listen (QHostAddress::LocalHost, port))
 	{
-		LOG ("Server listening on localhost, port %d", port)
+		LOG ("Server listening on localhost, port %d (%s)", port, ioMode == kPolling ? "polling" : "event-driven")
+		if(ioMode == kPolling)
+			timer.start ();
 	}
 	else
 	{
@@ -100,8 +233,14 @@ void NetworkServer::stop ()
 {
 	//LOG ("NetworkServer::stop")
 	
+	timer.stop ();
 	emit stopClients ();
 	close ();
+	
+#if ENABLE_ASIO_ENGINE
+	if(asioEngine)
+		asioEngine->stop ();
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -111,9 +250,51 @@ bool NetworkServer::broadcastJson (const QJsonObject& json)
 	if(connections.isEmpty ())
 		return false;
 	
-	for(auto connection : connections)
-		sendJson (*connection, json);
-	return true;
+	return broadcastPayload (QJsonDocument (json).toJson (QJsonDocument::Compact));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkServer::broadcastPayload (const QByteArray& payload)
+{
+	return broadcastPayload (payload, connections);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool NetworkServer::broadcastPayload (const QByteArray& payload, const QVector<NetworkConnection*>& recipients)
+{
+	if(recipients.isEmpty ())
+		return false;
+	
+	broadcastStatistics.broadcasts++;
+	broadcastStatistics.payloadEncodes++;
+	
+	// serialize once, frame once per framing in use, and queue the same (implicitly shared) buffer everywhere
+	QByteArray frames[kFramingV2 + 1];
+	bool encoded[kFramingV2 + 1] = {};
+	bool result = true;
+	for(auto connection : recipients)
+	{
+		NetworkFraming framing = connection->getFraming ();
+		if(!encoded[framing])
+		{
+			frames[framing] = NetworkWriter::encodeFrame (payload, framing);
+			encoded[framing] = true;
+			broadcastStatistics.frameEncodes++;
+		}
+		if(frames[framing].isEmpty ())
+		{
+			result = false; // refused, see NetworkWriter::encodeFrame ()
+			continue;
+		}
+		
+		connection->writeFrame (frames[framing]);
+		broadcastStatistics.framesQueued++;
+	}
+	
+	//LOG ("broadcast #%llu: %llu frames queued, %llu frames encoded so far", broadcastStatistics.broadcasts, broadcastStatistics.framesQueued, broadcastStatistics.frameEncodes)
+	return result;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -126,6 +307,17 @@ bool NetworkServer::sendJson (NetworkConnection& connection, const QJsonObject&
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool NetworkServer::sendPayload (NetworkConnection& connection, const QByteArray& payload)
+{
+	QByteArray frame = NetworkWriter::encodeFrame (payload, connection.getFraming ());
+	if(frame.isEmpty ())
+		return false; // refused, see NetworkWriter::encodeFrame ()
+	
+	return connection.writeFrame (frame);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
 void NetworkServer::incomingConnection (qintptr socketDescriptor)
 {
 	NetworkConnection* connection = new NetworkConnection (this);
@@ -134,6 +326,25 @@ void NetworkServer::incomingConnection (qintptr socketDescriptor)
 		delete connection;
 		return;
 	}
+	addConnection (connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::sessionAccepted (AsioSessionDevice* device)
+{
+#if ENABLE_ASIO_ENGINE
+	addConnection (new NetworkConnection (this, device));
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkServer::addConnection (NetworkConnection* connection)
+{
+	connection->setMaxFrameSize (maxFrameSize);
+	if(lowDelay)
+		connection->setLowDelay (true);
 	
 	connect (this, &NetworkServer::stopClients, connection, &NetworkConnection::terminate);
 	connect (connection, &NetworkConnection::disconnectedFromClient, this, &NetworkServer::connectionTerminated);
@@ -151,6 +362,11 @@ void NetworkServer::connectionTerminated (NetworkConnection& connection)
 {
 	//LOG ("NetworkServer::connectionTerminated");
 	
-	deadConnections.append (&connection);
+	if(!deadConnections.contains (&connection))
+		deadConnections.append (&connection);
 	emit connectionRemoved (connection);
+	
+	// the connection is still on the call stack, so delete it on the next turn (unless polling will)
+	if(ioMode != kPolling)
+		QTimer::singleShot (0, this, &NetworkServer::purgeDeadConnections);
 }
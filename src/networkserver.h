@@ -29,6 +29,9 @@
 #include <QTimer>
 
 class NetworkConnection;
+class AsioEngine;
+class AsioSessionDevice;
+class QThread;
 	
 //************************************************************************************************
 // NetworkServer
@@ -40,13 +43,44 @@ class NetworkServer: public QTcpServer
 public:
 	static const int kIdleMs = 30;
 	
+	enum IOMode
+	{
+		kEventDriven = 0, ///< sockets are serviced by the host's event loop as soon as they're ready, nothing runs while they're quiet. Checked once by start (), which falls back to polling if the server's thread has no running event loop
+		kPolling ///< fallback: sockets are pumped manually every kIdleMs
+	};
+	
+	struct BroadcastStatistics
+	{
+		quint64 broadcasts = 0; ///< calls to broadcastJson ()
+		quint64 payloadEncodes = 0; ///< json serializations done for them (one per broadcast)
+		quint64 frameEncodes = 0; ///< frames built for them (one per framing in use, per broadcast)
+		quint64 framesQueued = 0; ///< frames handed to connections, all sharing those buffers
+	};
+	
+	enum Engine
+	{
+		kQtEngine = 0, ///< QTcpServer/QTcpSocket on the OBS main thread
+		kAsioEngine ///< standalone asio on a dedicated I/O thread (if built with ENABLE_ASIO_ENGINE)
+	};
+	
 	NetworkServer (QObject* parent = nullptr);
 	~NetworkServer ();
 	
+	void setIOMode (IOMode mode);
+	IOMode getIOMode () const { return ioMode; }
+	void setEngine (Engine engine);
+	Engine getEngine () const { return engine; }
+	void setMaxFrameSize (qint64 bytes); ///< for frames received from clients
+	void setLowDelay (bool state); ///< TCP_NODELAY on client sockets, for latency-sensitive clients
+	
 	void start (qint16 port);
 	void stop ();
 	bool broadcastJson (const QJsonObject& json);
+	bool broadcastPayload (const QByteArray& payload); ///< json that is already serialized
+	bool broadcastPayload (const QByteArray& payload, const QVector<NetworkConnection*>& recipients); ///< to some of the connections only, false if it was too large for some of their framings
+	const BroadcastStatistics& getBroadcastStatistics () const { return broadcastStatistics; }
 	bool sendJson (NetworkConnection& connection, const QJsonObject& json);
+	bool sendPayload (NetworkConnection& connection, const QByteArray& payload); ///< json that is already serialized, false if it's too large for the connection's framing
 	
 signals:
 	void stopClients ();
@@ -58,12 +92,24 @@ protected:
 	// QTcpServer
 	void incomingConnection (qintptr socketDescriptor) override;
 	
+	void addConnection (NetworkConnection* connection);
+	bool isStarted () const;
+	static bool deliversEvents (QThread* thread); ///< the thread has an event loop that services notifiers, timers and queued calls
+	
 public slots:
 	void connectionTerminated (NetworkConnection& connection);
 	void idle ();
+	void purgeDeadConnections ();
+	void sessionAccepted (AsioSessionDevice* device);
 	
 private:
 	QVector<NetworkConnection*> connections;
 	QVector<NetworkConnection*> deadConnections;
 	QTimer timer;
+	IOMode ioMode;
+	Engine engine;
+	AsioEngine* asioEngine;
+	qint64 maxFrameSize;
+	bool lowDelay;
+	BroadcastStatistics broadcastStatistics;
 };
@@ -28,6 +28,8 @@
 #include "enumerators.h"
 #include "obsremoteprotocol.h"
 #include <obs-audio-controls.h>
+#include <QJsonDocument>
+#include <string.h>
 
 #include "moc_obsobjects.cpp"
 
@@ -35,9 +37,50 @@
 // Source
 //************************************************************************************************
 
-Source::Source (obs_source_t& _source)
-: source (&_source)
+static std::atomic<quint32> nextGeneration (1);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+Source::Source (obs_source_t& _source, SourceEventQueue* _events)
+: source (&_source),
+  events (_events),
+  generation (nextGeneration++)
+{
+	route.source = source;
+	route.generation = generation;
+	connectSignals ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+Source::Source (obs_source_t& _source, const Source* receiver, obs_sceneitem_t& sender)
+: source (&_source),
+  events (receiver ? receiver->events : nullptr),
+  generation (nextGeneration++)
+{
+	if(receiver)
+	{
+		route.source = receiver->source;
+		route.generation = receiver->generation;
+		route.sender = &sender;
+	}
+	else
+	{
+		route.source = source;
+		route.generation = generation;
+	}
+	connectSignals ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Source::connectSignals ()
 {
+	if(const char* sourceName = obs_source_get_name (source))
+		name = QString (sourceName);
+	else
+		name = "Error";
+
 	//LOG ("SOURCE + %s", STR (getName ()))
 	
 	if(signal_handler_t* handler = obs_source_get_signal_handler (source))
@@ -103,7 +146,7 @@ void Source::onDestroyed (void* param, calldata_t* data)
 	if(source->getInternal () != obsSource)
 		return;
 	
-	source->emit destroyed (*source);
+	source->post (SourceEvent::kDestroyed);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -116,7 +159,7 @@ void Source::onRemoved (void* param, calldata_t* data)
 	if(source->getInternal () != obsSource)
 		return;
 	
-	source->emit removed (*source);
+	source->post (SourceEvent::kRemoved);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -129,7 +172,7 @@ void Source::onActivated (void* param, calldata_t* data)
 	if(source->getInternal () != obsSource)
 		return;
 	
-	source->emit activated (*source, true);
+	source->post (SourceEvent::kActivated, nullptr, true);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -142,7 +185,7 @@ void Source::onDeactivated (void* param, calldata_t* data)
 	if(source->getInternal () != obsSource)
 		return;
 	
-	source->emit activated (*source, false);
+	source->post (SourceEvent::kActivated, nullptr, false);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -155,7 +198,7 @@ void Source::onShown (void* param, calldata_t* data)
 	if(source->getInternal () != obsSource)
 		return;
 	
-	source->emit shown (*source, true);
+	source->post (SourceEvent::kShown, nullptr, true);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -168,7 +211,7 @@ void Source::onHidden (void* param, calldata_t* data)
 	if(source->getInternal () != obsSource)
 		return;
 	
-	source->emit shown (*source, false);
+	source->post (SourceEvent::kShown, nullptr, false);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -184,7 +227,7 @@ void Source::onEnabled (void* param, calldata_t* data)
 	bool enabled = false;
 	if(!calldata_get_bool (data, "enabled", &enabled))
 		return;
-	source->emit enabled (*source, enabled);
+	source->post (SourceEvent::kEnabled, nullptr, enabled);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -196,7 +239,26 @@ void Source::onRenamed (void* param, calldata_t* data)
 	obs_source_t* obsSource = (obs_source_t*)calldata_ptr (data, "source");
 	if(source->getInternal () != obsSource)
 		return;
-	source->emit renamed (*source);
+	
+	source->post (SourceEvent::kRenamed); // the new name is picked up from the source when handled
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool isSceneSignal (const Scene& scene, calldata_t* data)
+{
+	// connected on the scene's own handler, but they carry the scene anyway
+	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
+	return obsScene && obsScene == scene.getInternalScene ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static obs_sceneitem_t* getSceneItem (const Scene& scene, calldata_t* data)
+{
+	if(!isSceneSignal (scene, data))
+		return nullptr;
+	return (obs_sceneitem_t*)calldata_ptr (data, "item");
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -205,8 +267,8 @@ void Source::onSceneItemAdded (void* param, calldata_t* data)
 {
 	//LOG ("Source::onSceneItemAdded")
 	Scene* scene = reinterpret_cast<Scene*> (param);
-	if(scene)
-		scene->handleSceneItemAdded (data);
+	if(obs_sceneitem_t* item = getSceneItem (*scene, data))
+		scene->post (SourceEvent::kItemAdded, item);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -215,8 +277,8 @@ void Source::onSceneItemRemoved (void* param, calldata_t* data)
 {
 	//LOG ("Source::onSceneItemRemoved")
 	Scene* scene = reinterpret_cast<Scene*> (param);
-	if(scene)
-		scene->handleSceneItemRemoved (data);
+	if(obs_sceneitem_t* item = getSceneItem (*scene, data))
+		scene->post (SourceEvent::kItemRemoved, item);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -225,8 +287,8 @@ void Source::onSceneItemReordered (void* param, calldata_t* data)
 {
 	LOG ("Source::onSceneItemReordered")
 	Scene* scene = reinterpret_cast<Scene*> (param);
-	if(scene)
-		scene->handleSceneItemsReordered (data);
+	if(isSceneSignal (*scene, data))
+		scene->post (SourceEvent::kItemsReordered);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -235,8 +297,8 @@ void Source::onSceneItemRefreshed (void* param, calldata_t* data)
 {
 	//LOG ("Source::onSceneItemRefreshed")
 	Scene* scene = reinterpret_cast<Scene*> (param);
-	if(scene)
-		scene->handleSceneItemsRefreshed (data);
+	if(isSceneSignal (*scene, data))
+		scene->post (SourceEvent::kItemsRefreshed);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -245,8 +307,10 @@ void Source::onSceneItemVisibilityChanged (void* param, calldata_t* data)
 {
 	//LOG ("Source::onSceneItemVisibilityChanged")
 	Scene* scene = reinterpret_cast<Scene*> (param);
-	if(scene)
-		scene->handleSceneItemVisibilityChanged (data);
+	obs_sceneitem_t* item = getSceneItem (*scene, data);
+	bool visible = false;
+	if(item && calldata_get_bool (data, "visible", &visible))
+		scene->post (SourceEvent::kItemVisible, item, visible);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -255,31 +319,73 @@ void Source::onSceneItemLockChanged (void* param, calldata_t* data)
 {
 	//LOG ("Source::onSceneItemLockChanged")
 	Scene* scene = reinterpret_cast<Scene*> (param);
-	if(scene)
-		scene->handleSceneItemLockChanged (data);
+	obs_sceneitem_t* item = getSceneItem (*scene, data);
+	bool locked = false;
+	if(item && calldata_get_bool (data, "locked", &locked))
+		scene->post (SourceEvent::kItemLocked, item, locked);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QString Scene::getTypeString () const
+void Source::post (SourceEvent::Kind kind, obs_sceneitem_t* item, bool state)
 {
-	return "Scene";
+	SourceEvent event = route;
+	event.kind = kind;
+	event.item = item;
+	event.state = state;
+	
+	if(events)
+		events->post (event); // handled on the queue's thread, see SceneModel::dispatchEvents ()
+	else // only short-lived wrappers, e.g. those of the Enumerators, have no queue, nobody listens to them
+	{
+		LOG ("Source: no event queue, dropped event %d", int (kind))
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-obs_scene_t* Scene::getInternalScene () const
+void Source::handleEvent (const SourceEvent& event)
 {
-	return obs_scene_from_source (getInternal ()); // does not increase reference
+	switch(event.kind)
+	{
+	case SourceEvent::kDestroyed :
+		emit destroyed (*this);
+		break;
+	case SourceEvent::kRemoved :
+		emit removed (*this);
+		break;
+	case SourceEvent::kActivated :
+		emit activated (*this, event.state);
+		break;
+	case SourceEvent::kShown :
+		emit shown (*this, event.state);
+		break;
+	case SourceEvent::kEnabled :
+		emit enabled (*this, event.state);
+		break;
+	case SourceEvent::kRenamed :
+		if(const char* newName = obs_source_get_name (source))
+			name = QString (newName);
+		invalidate ();
+		emit renamed (*this);
+		break;
+	default :
+		break;
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QString Source::getName () const
+QString Scene::getTypeString () const
 {
-	if(const char* sourceName = obs_source_get_name (source))
-		return QString (sourceName);
-	return "Error";
+	return "Scene";
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+obs_scene_t* Scene::getInternalScene () const
+{
+	return obs_scene_from_source (getInternal ()); // does not increase reference
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -311,8 +417,10 @@ void Source::debug ()
 // Scene
 //************************************************************************************************
 
-Scene::Scene (obs_source_t& _source)
-: Source (_source)
+Scene::Scene (obs_source_t& _source, SourceEventQueue* _events)
+: Source (_source, _events),
+  serializedDirty (true),
+  applying (false)
 {
 	regenerateSources ();
 }
@@ -321,127 +429,311 @@ Scene::Scene (obs_source_t& _source)
 
 Scene::~Scene ()
 {
-	Enumerators::destroy (sceneSources);
+	destroySources ();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void Scene::regenerateSources ()
 {
-	Enumerators::destroy (sceneSources);
-	Enumerators::enumerateSceneSources (sceneSources, *this);
+	destroySources ();
+	synchronizeSources ();
+	invalidate ();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-SceneSource* Scene::findSceneSource (obs_sceneitem_t& obsSceneItem) const
+bool Scene::synchronizeSources ()
 {
-	for(auto i : getSources ())
+	QVector<obs_sceneitem_t*> obsSceneItems;
+	obsSceneItems.reserve (sceneSources.count ());
+	Enumerators::enumerateSceneItems (obsSceneItems, *this);
+	
+	// keep the wrappers of items we already know, only new items get a new SceneSource
+	QHash<obs_sceneitem_t*, SceneSource*> remaining;
+	remaining.swap (itemIndex);
+	QVector<SceneSource*> synchronized;
+	synchronized.reserve (obsSceneItems.count ());
+	bool added = false;
+	
+	for(auto obsSceneItem : obsSceneItems)
+	{
+		if(!obsSceneItem || itemIndex.contains (obsSceneItem))
+			continue;
+		
+		SceneSource* sceneSource = remaining.take (obsSceneItem);
+		if(!sceneSource)
+		{
+			sceneSource = new SceneSource (*obsSceneItem, this);
+			itemIdIndex.insert (sceneSource->getItemId (), sceneSource);
+			added = true;
+		}
+		synchronized.append (sceneSource);
+		itemIndex.insert (obsSceneItem, sceneSource);
+	}
+	
+	bool changed = added || !remaining.isEmpty () || synchronized != sceneSources;
+	sceneSources.swap (synchronized);
+	
+	for(auto sceneSource : remaining)
 	{
-		if(i->getInternalSceneItem () == &obsSceneItem)
-			return i;
+		itemIdIndex.remove (sceneSource->getItemId ());
+		delete sceneSource;
 	}
-	return nullptr;
+	if(changed)
+		invalidate ();
+	return changed;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Scene::handleSceneItemAdded (calldata_t* data)
+void Scene::destroySources ()
 {
-	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
-	obs_sceneitem_t* obsSceneItem = (obs_sceneitem_t*)calldata_ptr (data, "item");
-	if(!obsScene || !obsSceneItem)
-		return;
+	itemIndex.clear ();
+	itemIdIndex.clear ();
+	Enumerators::destroy (sceneSources);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Scene::invalidate ()
+{
+	serializedDirty = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonObject Scene::toJson () const
+{
+	QJsonObject json = Source::toJson ();
 	
-	if(getInternalScene () != obsScene)
+	QJsonArray items;
+	int sortIndex = 0;
+	for(auto i : sceneSources)
+	{
+		QJsonObject sceneSource = i->toJson ();
+		sceneSource[OBSRemoteProtocol::kSourceSortIndex] = sortIndex++;
+		items.push_back (sceneSource);
+	}
+	json[OBSRemoteProtocol::kSceneSourcesList] = items;
+	return json;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+const QByteArray& Scene::getSerialized () const
+{
+	if(serializedDirty)
+	{
+		serialized = QJsonDocument (toJson ()).toJson (QJsonDocument::Compact);
+		serializedDirty = false;
+	}
+	return serialized;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+SceneSource* Scene::findSceneSource (obs_sceneitem_t& obsSceneItem) const
+{
+	return itemIndex.value (&obsSceneItem, nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+SceneSource* Scene::findSceneSource (qint64 itemId) const
+{
+	return itemIdIndex.value (itemId, nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Scene::handleEvent (const SourceEvent& event)
+{
+	if(event.sender) // one of our items' own signals
+	{
+		if(SceneSource* sceneSource = findSceneSource (*event.sender))
+			sceneSource->handleEvent (event);
 		return;
+	}
 	
-	regenerateSources ();
-	if(SceneSource* sceneSource = findSceneSource (*obsSceneItem))
-		emit sceneSourceAdded (*this, *sceneSource);
+	switch(event.kind)
+	{
+	case SourceEvent::kItemAdded :
+		handleSceneItemAdded (event.item);
+		break;
+	case SourceEvent::kItemRemoved :
+		handleSceneItemRemoved (event.item);
+		break;
+	case SourceEvent::kItemsReordered :
+		handleSceneItemsReordered ();
+		break;
+	case SourceEvent::kItemsRefreshed :
+		handleSceneItemsRefreshed ();
+		break;
+	case SourceEvent::kItemVisible :
+		handleSceneItemVisibilityChanged (event.item, event.state);
+		break;
+	case SourceEvent::kItemLocked :
+		handleSceneItemLockChanged (event.item, event.state);
+		break;
+	default :
+		Source::handleEvent (event);
+		break;
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Scene::handleSceneItemRemoved (calldata_t* data)
+void Scene::handleSceneItemAdded (obs_sceneitem_t* obsSceneItem)
 {
-	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
-	obs_sceneitem_t* obsSceneItem = (obs_sceneitem_t*)calldata_ptr (data, "item");
-	if(!obsScene || !obsSceneItem)
+	if(itemIndex.contains (obsSceneItem))
 		return;
 	
-	if(getInternalScene () != obsScene)
-		return;
+	// the new item goes right above the closest item below it we know, the others are left alone
+	QVector<obs_sceneitem_t*> obsSceneItemsBelow;
+	if(!Enumerators::enumerateSceneItemsBelow (obsSceneItemsBelow, *this, obsSceneItem))
+		return; // already gone again
+	
+	int position = sceneSources.count ();
+	for(int i = obsSceneItemsBelow.count () - 1; i >= 0; i--)
+		if(SceneSource* below = itemIndex.value (obsSceneItemsBelow[i]))
+		{
+			position = sceneSources.indexOf (below);
+			break;
+		}
+	
+	SceneSource* sceneSource = new SceneSource (*obsSceneItem, this);
+	sceneSources.insert (position, sceneSource);
+	itemIndex.insert (obsSceneItem, sceneSource);
+	itemIdIndex.insert (sceneSource->getItemId (), sceneSource);
+	invalidate ();
 	
+	emit sceneSourceAdded (*this, *sceneSource);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Scene::handleSceneItemRemoved (obs_sceneitem_t* obsSceneItem)
+{
 	if(SceneSource* sceneSource = findSceneSource (*obsSceneItem))
 	{	
 		emit sceneSourceRemoved (*this, *sceneSource);
-		regenerateSources ();
+		
+		itemIndex.remove (obsSceneItem);
+		itemIdIndex.remove (sceneSource->getItemId ());
+		sceneSources.removeOne (sceneSource);
+		delete sceneSource;
+		invalidate ();
 	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Scene::handleSceneItemsReordered (calldata_t* data)
+void Scene::handleSceneItemsReordered ()
 {
-	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
-	if(getInternalScene () != obsScene)
+	if(!synchronizeSources ()) // already known, e.g. from apply ()
 		return;
-	regenerateSources ();
 	LOG ("Scene::handleSceneItemsReordered")
-	emit sceneSourcesReordered (*this);
+	if(!applying)
+		emit sceneSourcesReordered (*this);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Scene::handleSceneItemsRefreshed (calldata_t* data)
+void Scene::handleSceneItemsRefreshed ()
 {
-	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
-	if(getInternalScene () != obsScene)
-		return;
-	
+	regenerateSources (); // groups have changed, the items we have may not be the scene's anymore
 	emit sceneSourcesRefreshed (*this);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Scene::handleSceneItemVisibilityChanged (calldata_t* data)
+void Scene::handleSceneItemVisibilityChanged (obs_sceneitem_t* obsSceneItem, bool visible)
 {
-	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
-	obs_sceneitem_t* obsSceneItem = (obs_sceneitem_t*)calldata_ptr (data, "item");
-	if(!obsScene || !obsSceneItem)
-		return;
-	
-	if(getInternalScene () != obsScene)
-		return;
-	
-	if(SceneSource* sceneSource = findSceneSource (*obsSceneItem))
+	SceneSource* sceneSource = findSceneSource (*obsSceneItem);
+	if(sceneSource && sceneSource->visible != visible) // it's already known if it came from apply ()
 	{
-		bool visible = false;
-		if(!calldata_get_bool (data, "visible", &visible))
-			return;
-		emit sceneSourceVisibilityChanged (*this, *sceneSource, visible);
+		sceneSource->visible = visible;
+		invalidate ();
+		if(!applying)
+			emit sceneSourceVisibilityChanged (*this, *sceneSource, visible);
 	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Scene::handleSceneItemLockChanged (calldata_t* data)
+void Scene::handleSceneItemLockChanged (obs_sceneitem_t* obsSceneItem, bool locked)
 {
-	obs_scene_t* obsScene = (obs_scene_t*)calldata_ptr (data, "scene");
-	obs_sceneitem_t* obsSceneItem = (obs_sceneitem_t*)calldata_ptr (data, "item");
-	if(!obsScene || !obsSceneItem)
-		return;
+	SceneSource* sceneSource = findSceneSource (*obsSceneItem);
+	if(sceneSource && sceneSource->locked != locked)
+	{
+		sceneSource->locked = locked;
+		invalidate ();
+		if(!applying)
+			emit sceneSourceLockChanged (*this, *sceneSource, locked);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Scene::resynchronize (bool notify)
+{
+	QString oldName = name;
+	if(const char* newName = obs_source_get_name (source))
+		name = QString (newName);
+	if(notify && name != oldName)
+		emit renamed (*this);
 	
-	if(getInternalScene () != obsScene)
-		return;
+	regenerateSources ();
+	if(notify)
+		emit sceneSourcesRefreshed (*this);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Scene::apply (const SceneUpdate& update)
+{
+	if(update.isEmpty ())
+		return false;
 	
-	if(SceneSource* sceneSource = findSceneSource (*obsSceneItem))
+	// OBS raises a signal for each change while it applies them, they're posted to the event queue,
+	// and should one be handled before we're done, it's only collected
+	applying = true;
+	obs_scene_atomic_update (getInternalScene (), applyAtomic, const_cast<SceneUpdate*> (&update));
+	applying = false;
+	
+	// the signals still queued find our state up to date and are skipped. It's what OBS has now,
+	// not what was asked for, a change it didn't make isn't reported as made
+	for(auto& change : update.visible)
+		change.first->visible = obs_sceneitem_visible (change.first->getInternalSceneItem ());
+	for(auto& change : update.locked)
+		change.first->locked = obs_sceneitem_locked (change.first->getInternalSceneItem ());
+	if(!update.order.isEmpty ())
+		synchronizeSources ();
+	invalidate ();
+	
+	emit sceneSourcesChanged (*this);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Scene::applyAtomic (void* data, obs_scene_t* obsScene)
+{
+	const SceneUpdate& update = *reinterpret_cast<const SceneUpdate*> (data);
+	for(auto& change : update.visible)
+		obs_sceneitem_set_visible (change.first->getInternalSceneItem (), change.second);
+	for(auto& change : update.locked)
+		obs_sceneitem_set_locked (change.first->getInternalSceneItem (), change.second);
+	
+	if(!update.order.isEmpty ())
 	{
-		bool locked = false;
-		if(!calldata_get_bool (data, "locked", &locked))
-			return;
-		emit sceneSourceLockChanged (*this, *sceneSource, locked);
+		// OBS wants them bottom first
+		QVector<obs_sceneitem_t*> itemOrder;
+		itemOrder.reserve (update.order.count ());
+		for(auto i = update.order.crbegin (); i != update.order.crend (); ++i)
+			itemOrder.append ((*i)->getInternalSceneItem ());
+		obs_scene_reorder_items (obsScene, itemOrder.constData (), size_t (itemOrder.count ()));
 	}
 }
 
@@ -449,9 +741,13 @@ void Scene::handleSceneItemLockChanged (calldata_t* data)
 // SceneSource
 //************************************************************************************************
 
-SceneSource::SceneSource (obs_sceneitem_t& _item)
-: Source (*obs_sceneitem_get_source (&_item)), // obs_sceneitem_get_source doesn't add a ref-count
-  item (&_item) 
+SceneSource::SceneSource (obs_sceneitem_t& _item, Scene* _parentScene)
+: Source (*obs_sceneitem_get_source (&_item), _parentScene, _item), // obs_sceneitem_get_source doesn't add a ref-count
+  item (&_item),
+  itemId (obs_sceneitem_get_id (&_item)),
+  visible (obs_sceneitem_visible (&_item)),
+  locked (obs_sceneitem_locked (&_item)),
+  parentScene (_parentScene)
 {
 	//LOG ("SceneSource +")
 }
@@ -472,6 +768,14 @@ QString SceneSource::getTypeString () const
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+void SceneSource::invalidate ()
+{
+	if(parentScene)
+		parentScene->invalidate ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
 QJsonObject SceneSource::toJson () const
 {
 	QJsonObject json = Source::toJson ();
@@ -482,15 +786,6 @@ QJsonObject SceneSource::toJson () const
 	
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool SceneSource::isVisible () const
-{
-	if(item)
-		return obs_sceneitem_visible (item);
-	return false;
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////////////
-
 void SceneSource::setVisible (bool state)
 {
 	if(item)
@@ -499,15 +794,6 @@ void SceneSource::setVisible (bool state)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool SceneSource::isLocked () const
-{
-	if(item)
-		return obs_sceneitem_locked (item);
-	return false;
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////////////
-
 void SceneSource::setLocked (bool state)
 {
 	if(item)
@@ -547,18 +833,34 @@ void AudioMeter::handleLevel (void* meter, const float magnitude[MAX_AUDIO_CHANN
 
 void AudioMeter::updateLevel (const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS], const float inputPeak[MAX_AUDIO_CHANNELS])
 {
-	for(int i = 0; i < MAX_AUDIO_CHANNELS; ++i)
+	// audio thread: no locks, no allocations
+	MeterLevels reading;
+	memcpy (reading.magnitude, magnitude, sizeof (reading.magnitude));
+	memcpy (reading.peak, peak, sizeof (reading.peak));
+	memcpy (reading.inputPeak, inputPeak, sizeof (reading.inputPeak));
+	levels.push (reading);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AudioMeter::readLevels (MeterLevels& held)
+{
+	bool any = false;
+	MeterLevels reading;
+	while(levels.pop (reading))
 	{
-		LOG ("AudioMeter::updateLevel [%d] Volume: %.2f, %.2f, %.2f\n", i, magnitude[i], peak[i], inputPeak[i]);
+		held.hold (reading);
+		any = true;
 	}
+	return any;
 }
 
 //************************************************************************************************
 // Input
 //************************************************************************************************
 
-Input::Input (obs_source_t& source)
-: Source (source)
+Input::Input (obs_source_t& source, SourceEventQueue* events)
+: Source (source, events)
 {
 	//LOG ("Input +")
 }
@@ -574,8 +876,8 @@ QString Input::getTypeString () const
 // Filter
 //************************************************************************************************
 
-Filter::Filter (obs_source_t& source)
-: Source (source)
+Filter::Filter (obs_source_t& source, SourceEventQueue* events)
+: Source (source, events)
 {
 	//LOG ("Filter +")
 }
@@ -591,8 +893,8 @@ QString Filter::getTypeString () const
 // Transition
 //************************************************************************************************
 
-Transition::Transition (obs_source_t& source)
-: Source (source)
+Transition::Transition (obs_source_t& source, SourceEventQueue* events)
+: Source (source, events)
 {
 	//LOG ("Transition +")
 }
@@ -744,18 +1046,28 @@ int Output::getTotalBytes () const
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QString Output::getTimeString () const
+quint64 Output::getTimeNanos () const
 {
 	if(!obs_output_active (output))
-		return kNoTimeString;
+		return 0;
 	
 	video_t* videoOutput = obs_output_video (output);
 	if(!videoOutput)
-		return kNoTimeString;
+		return 0;
 	
 	uint64_t frameTimeNanos = video_output_get_frame_time (videoOutput);
 	int totalFrames = obs_output_get_total_frames (output);
-	uint64_t totalNanos  = frameTimeNanos * static_cast<uint64_t> (totalFrames);
+	return frameTimeNanos * static_cast<uint64_t> (totalFrames);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QString Output::getTimeString () const
+{
+	if(!obs_output_active (output) || !obs_output_video (output))
+		return kNoTimeString;
+	
+	uint64_t totalNanos = getTimeNanos ();
 	uint64_t totalRecordSeconds = totalNanos / 1000000000;
 	
 	int seconds = totalRecordSeconds % 60;
@@ -26,12 +26,21 @@
 #include <QtCore/QObject>
 #include <QString>
 #include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QByteArray>
 #include <QJsonObject>
+#include <QJsonArray>
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 #include <util/platform.h>
 #include <obs.hpp>
 
+#include "levelqueue.h"
+#include "sourceevents.h"
+
+#include <atomic>
+
 //************************************************************************************************
 // Source
 //************************************************************************************************
@@ -40,17 +49,20 @@ class Source : public QObject
 {
 	Q_OBJECT
 public:
-	Source (obs_source_t& source);
+	Source (obs_source_t& source, SourceEventQueue* events = nullptr); ///< with events, signals are emitted from handleEvent () on the queue's thread, without, OBS signals are dropped
 	virtual ~Source ();
 	
-	QString getName () const;
+	QString getName () const { return name; } ///< cached, kept current by the source's rename signal
 	QString getId () const;
 	
 	obs_source_t* getInternal () const { return source; }
+	quint32 getGeneration () const { return generation; } ///< unique per wrapper, tells its events from those of an earlier wrapper of the same address
 	
 	virtual QJsonObject toJson () const;	
+	virtual void invalidate () {} ///< something toJson () reports has changed
 	virtual void debug ();
 	virtual QString getTypeString () const = 0;
+	virtual void handleEvent (const SourceEvent& event); ///< updates what's cached and emits the matching signal
 	
 	static void onDestroyed (void* param, calldata_t* data);
 	static void onRemoved (void* param, calldata_t* data);
@@ -77,32 +89,65 @@ signals:
 	void renamed (const Source& source); ///< the source has been renamed
 	
 protected:
+	Source (obs_source_t& source, const Source* receiver, obs_sceneitem_t& sender); ///< for scene items, with a receiver (the parent scene) their events are posted as its
+	
+	void connectSignals ();
+	void post (SourceEvent::Kind kind, obs_sceneitem_t* item = nullptr, bool state = false);
+	
 	OBSSource source; // ref-counted
+	QString name;
+	SourceEventQueue* events;
+	quint32 generation;
+	SourceEvent route; ///< source, generation and sender of the events we post
 };
 
 //************************************************************************************************
 // SceneSource
 //************************************************************************************************
 
+class Scene;
+
 class SceneSource : public Source
 {
 public:
-	SceneSource (obs_sceneitem_t& item);
+	SceneSource (obs_sceneitem_t& item, Scene* parentScene = nullptr); ///< with a parent, its signals take the parent scene's event queue
 	~SceneSource ();
 	
 	obs_sceneitem_t* getInternalSceneItem () const { return item; }
+	qint64 getItemId () const { return itemId; } ///< unique within the scene
 	
-	bool isVisible () const;
+	bool isVisible () const { return visible; } ///< cached, kept current by the parent scene's item_visible signal
 	void setVisible (bool state);
-	bool isLocked () const;
+	bool isLocked () const { return locked; } ///< cached, kept current by the parent scene's item_locked signal
 	void setLocked (bool state);
 	
 	// Source
 	QString getTypeString () const override;
 	virtual QJsonObject toJson () const override;
+	void invalidate () override;
 	
 protected:
+	friend class Scene;
+	
 	OBSSceneItem item; // ref-counted
+	qint64 itemId;
+	std::atomic<bool> visible;
+	std::atomic<bool> locked;
+	Scene* parentScene;
+};
+
+//************************************************************************************************
+// SceneUpdate
+//************************************************************************************************
+
+/** Changes to many of a scene's sources at once, see Scene::apply (). */
+struct SceneUpdate
+{
+	QVector<QPair<SceneSource*, bool>> visible;
+	QVector<QPair<SceneSource*, bool>> locked;
+	QVector<SceneSource*> order; ///< all of the scene's sources, top first, empty to keep the order
+	
+	bool isEmpty () const { return visible.isEmpty () && locked.isEmpty () && order.isEmpty (); }
 };
 
 //************************************************************************************************
@@ -113,22 +158,30 @@ class Scene : public Source
 {
 	Q_OBJECT
 public:
-	Scene (obs_source_t& source);
+	Scene (obs_source_t& source, SourceEventQueue* events = nullptr);
 	~Scene ();
 	
 	obs_scene_t* getInternalScene () const;
-	const QVector<SceneSource*> getSources () const { return sceneSources; }
+	const QVector<SceneSource*>& getSources () const { return sceneSources; } ///< top first
 	SceneSource* findSceneSource (obs_sceneitem_t& obsSceneItem) const;
+	SceneSource* findSceneSource (qint64 itemId) const;
 	
-	void handleSceneItemAdded (calldata_t* data);
-	void handleSceneItemRemoved (calldata_t* data);
-	void handleSceneItemsReordered (calldata_t* data);
-	void handleSceneItemsRefreshed (calldata_t* data);
-	void handleSceneItemVisibilityChanged (calldata_t* data);
-	void handleSceneItemLockChanged (calldata_t* data);
+	void handleSceneItemAdded (obs_sceneitem_t* item);
+	void handleSceneItemRemoved (obs_sceneitem_t* item);
+	void handleSceneItemsReordered ();
+	void handleSceneItemsRefreshed ();
+	void handleSceneItemVisibilityChanged (obs_sceneitem_t* item, bool visible);
+	void handleSceneItemLockChanged (obs_sceneitem_t* item, bool locked);
+	void resynchronize (bool notify = true); ///< catches up with OBS after events were lost, notify: emit renamed () and sceneSourcesRefreshed ()
+	bool apply (const SceneUpdate& update); ///< in a single obs_scene_atomic_update, followed by a single sceneSourcesChanged (), false if there was nothing to apply
+	
+	const QByteArray& getSerialized () const; ///< compact toJson (), cached until the scene or one of its items changes
 	
 	// Source
 	QString getTypeString () const override;
+	QJsonObject toJson () const override; ///< name and sources
+	void invalidate () override;
+	void handleEvent (const SourceEvent& event) override;
 	
 signals:
 	void sceneSourceAdded (const Scene& scene, const SceneSource& source); ///< Called when a scene source has been added to the scene
@@ -137,11 +190,20 @@ signals:
 	void sceneSourcesRefreshed (const Scene& scene); ///< Called when the entire scene sources list needs to be refreshed. Usually this is only used when groups have changed
 	void sceneSourceVisibilityChanged (const Scene& scene, const SceneSource& source, bool visible); ///<  Called when a scene source's visibility state changes
 	void sceneSourceLockChanged (const Scene& scene, const SceneSource& source, bool locked); ///<  Called when a scene source has been locked or unlocked
+	void sceneSourcesChanged (const Scene& scene); ///< Called once after apply (), instead of the signals above for each of the changes
 	
 protected:
-	void regenerateSources ();
+	void regenerateSources (); ///< new wrappers for all items
+	static void applyAtomic (void* update, obs_scene_t* obsScene);
+	bool synchronizeSources (); ///< matches sceneSources to the scene's items, keeping the wrappers of those we have, returns true if anything changed
+	void destroySources ();
 	
 	QVector<SceneSource*> sceneSources;
+	QHash<obs_sceneitem_t*, SceneSource*> itemIndex;
+	QHash<qint64, SceneSource*> itemIdIndex;
+	mutable QByteArray serialized; ///< like all of the scene's state, only used on the thread handling its events
+	mutable bool serializedDirty;
+	bool applying; ///< inside apply (), item changes are only collected, it signals them once when it returns
 };
 
 //************************************************************************************************
@@ -151,7 +213,7 @@ protected:
 class Input : public Source
 {
 public:
-	Input (obs_source_t& source);
+	Input (obs_source_t& source, SourceEventQueue* events = nullptr);
 	
 	// Source
 	QString getTypeString () const override;
@@ -164,7 +226,7 @@ public:
 class Filter : public Source
 {
 public:
-	Filter (obs_source_t& source);
+	Filter (obs_source_t& source, SourceEventQueue* events = nullptr);
 	
 	// Source
 	QString getTypeString () const override;
@@ -177,7 +239,7 @@ public:
 class Transition : public Source
 {
 public:
-	Transition (obs_source_t& source);
+	Transition (obs_source_t& source, SourceEventQueue* events = nullptr);
 	
 	// Source
 	QString getTypeString () const override;
@@ -187,17 +249,21 @@ public:
 // AudioMeter
 //************************************************************************************************
 
+/** Levels arrive on the audio thread and are queued without locking, readLevels () picks them up on ours. */
 class AudioMeter
 {
 public:
 	AudioMeter (obs_source_t& source);
 	~AudioMeter ();
 	
+	bool readLevels (MeterLevels& levels); ///< folds everything queued since the last call into levels (see MeterLevels::hold ()), false if nothing was
+	
 	void updateLevel (const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS], const float input_peak[MAX_AUDIO_CHANNELS]);
 private:
 	static void handleLevel (void* meter, const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS], const float input_peak[MAX_AUDIO_CHANNELS]);
 	
 	obs_volmeter_t* meter;
+	LevelQueue levels;
 };
 
 //************************************************************************************************
@@ -226,6 +292,7 @@ public:
 	double getFramesPerSecond () const;
 	QString getFramesPerSecondString () const;
 	int getTotalBytes () const;
+	quint64 getTimeNanos () const; ///< time streamed/recorded so far
 	QString getTimeString () const;
 	
 	virtual void debug ();
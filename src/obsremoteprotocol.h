@@ -77,8 +77,30 @@ namespace OBSRemoteProtocol
 	static const int kPortDefault =	2021; ///< The port the OBS Remote Plugin will listen on, unless otherwise specified in /blah/obs-remote/config.json
 	static const int kPortMax = 65353;
 	constexpr static const char* kPortId = "port";
+	constexpr static const char* kIOModeId = "ioMode"; ///< optional in config.json: how sockets are serviced
+		constexpr static const char* kIOModeEvents = "events"; ///< (default) as soon as they're ready, via the host's event loop
+		constexpr static const char* kIOModePolling = "polling"; ///< every few ms on a timer, for hosts that don't pump the event loop
+	constexpr static const char* kEngineId = "engine"; ///< optional in config.json: which network engine services the sockets
+		constexpr static const char* kEngineQt = "qt"; ///< (default) Qt sockets on the OBS main thread
+		constexpr static const char* kEngineAsio = "asio"; ///< standalone asio on a dedicated I/O thread
+	constexpr static const char* kMaxFrameSizeId = "maxFrameSize"; ///< optional in config.json: largest message (in bytes) accepted from a client
+	constexpr static const char* kTcpNoDelayId = "tcpNoDelay"; ///< optional in config.json: true disables Nagle's algorithm on client sockets
+	constexpr static const char* kSceneDebounceId = "sceneDebounceMs"; ///< optional in config.json: quiet period before a burst of scene item changes is sent
+	constexpr static const char* kSceneMaxLatencyId = "sceneMaxLatencyMs"; ///< optional in config.json: longest a scene item change is held back during a burst
+	constexpr static const char* kFlushWindowId = "flushWindowMs"; ///< optional in config.json: how long outgoing values are gathered into one message (0: until the end of the event loop turn)
 
 	static const int kNumHeaderBytes = 4; ///< Each json message on the socket is prepended with the # of bytes proceeding
+	static const int kMaxPayloadBytesLegacy = 9999; ///< the most a 4 digit header can describe
+	
+	/// Protocol v2 framing: instead of the 4 ascii digits, a message may start with kFrameMagicV2,
+	/// followed by the # of bytes proceeding as a 32-bit big-endian integer. Once a client sets kItemFraming
+	/// to v2 (or sends a v2 message), everything the server sends to it is framed the same way, with no size limit.
+	/// Until then (and for legacy clients) the values of a larger message are split over several messages,
+	/// a single value over kMaxPayloadBytesLegacy is not sent. The initial state goes out on connect in legacy
+	/// framing, and again after kItemFraming switches to v2.
+	static const unsigned char kFrameMagicV2 = 0xB2; ///< never an ascii digit, so both framings can be told apart per message
+	static const int kNumHeaderBytesV2 = 5;
+	static const unsigned char kFrameMagicMeters = 0xB3; ///< binary audio levels instead of json, same header as v2 (see kLevelFormatBinary8), only sent to v2 clients that asked for them
 	static const int kKeepAliveMs = 5000;  ///< the server expects to receive a message of some kind
 
 	/// An array of Value Items is passed back and forth. 
@@ -87,6 +109,10 @@ namespace OBSRemoteProtocol
 		constexpr static const char* kValueItemType = "type"; ///< type of the item (get/set)
 			constexpr static const char* kValueItemTypeGet = "get";
 			constexpr static const char* kValueItemTypeSet = "set";
+			constexpr static const char* kValueItemTypeSubscribe = "subscribe"; ///< from then on, only the items subscribed to are broadcast to the client (and the current value is sent right away). Telemetry items are pushed at their own rate instead, and don't narrow the broadcasts
+			constexpr static const char* kValueItemTypeUnsubscribe = "unsubscribe"; ///< stop pushing the item. Clients that never subscribed receive every broadcast item
+				constexpr static const char* kSubscribeInterval = "interval"; ///< optional with 'subscribe' to a telemetry item (cpu, memory, disk, output statistics, times): push it every # ms (default 1000)
+				constexpr static const char* kSubscribeDeadband = "deadband"; ///< optional with 'subscribe' to a telemetry item: skip values within # of the last one sent, in the unit of kValueModeRaw (0: skip unchanged values). Per item, the interval is per client
 		constexpr static const char* kValueItemName = "name"; ///< name of the item
 		constexpr static const char* kValueItemValue = "value";  ///< value of the item
 
@@ -107,12 +133,65 @@ namespace OBSRemoteProtocol
 		constexpr static const char* kItemSceneList = "sceneList"; ///< kValueItemValue: (Get: An array of Scenes) (Set: the name of the desired current/preview scene, depending on Studio Mode)
 		constexpr static const char* kItemCurrentScene = "currentScene"; ///< kValueItemValue: String name of the currently active scene (Get/Set)
 		constexpr static const char* kItemPreviewScene = "previewScene"; ///< kValueItemValue: String name of the current preview scene (Get/Set)
-		constexpr static const char* kItemSceneSourcesLocks = "sourceLocks"; ///< kValueItemValue: Integer 32-bit mask of lock states for the current scene's sources, in-order (Get/Set)
-		constexpr static const char* kItemSceneSourcesVisibles = "sourceVisibles"; ///< kValueItemValue: Integer 32-bit mask of visible states for the current scene's sources, in-order (Get/Set)
+		constexpr static const char* kItemSceneSourcesLocks = "sourceLocks"; ///< kValueItemValue: Integer 32-bit mask of lock states for the current scene's first 32 sources, in-order (Get/Set, see kItemSceneSourcesLockBits for more)
+		constexpr static const char* kItemSceneSourcesVisibles = "sourceVisibles"; ///< kValueItemValue: Integer 32-bit mask of visible states for the current scene's first 32 sources, in-order (Get/Set, see kItemSceneSourcesVisibleBits for more)
 		constexpr static const char* kItemTransitionList = "transitionsList"; ///< kValueItemValue: An array of Transitions (Get)
 		constexpr static const char* kItemTransitionCurrent = "currentTransition"; ///< kValueItemValue: String (name of transition) (Get/Set)
 		constexpr static const char* kItemTransitionCurrentDuration = "transitionDuration"; ///< kValueItemValue: Integer (duration of current transition) (Get/Set)
 
+		/// Per connection, not part of kValueItemNames:
+		constexpr static const char* kItemValueMode = "valueMode"; ///< kValueItemValue: String (Set: one of the modes below, the server confirms with the mode in effect. Servers that don't know it don't reply)
+			constexpr static const char* kValueModeFormatted = "formatted"; ///< the default, telemetry as display strings ("0.79%", "123.4 MB", "00:01:02")
+			constexpr static const char* kValueModeRaw = "raw"; ///< telemetry as numbers in fixed units: percent (cpuUsage, congestion), bytes (memoryUsage, freeDisk, -1 if unknown), fps, ns (recordingTime, streamingTime), frames
+		constexpr static const char* kItemFraming = "framing"; ///< kValueItemValue: String (Set: one of the framings below, the server confirms with the framing in effect, in that framing. Servers that don't know it don't reply)
+			constexpr static const char* kFramingNameLegacy = "legacy"; ///< the default, 4 ascii digits (kNumHeaderBytes), until the client sends a v2 message
+			constexpr static const char* kFramingNameV2 = "v2"; ///< kFrameMagicV2 headers, the initial state is sent again in this framing
+
+		/// Get only, with parameters, not part of kValueItemNames:
+		constexpr static const char* kItemStatsHistory = "statsHistory"; ///< kValueItemValue: (Get: an optional object with the parameters below) the reply is an object with start, step and count, and one object per series with min, max and avg arrays, one element per bucket
+			constexpr static const char* kHistorySeconds = "seconds"; ///< how far back from now (default 600, the server keeps an hour)
+			constexpr static const char* kHistoryBuckets = "buckets"; ///< how many buckets the range is split into (default 60, at most 1000)
+			constexpr static const char* kHistorySeries = "series"; ///< array of series names (default all): cpuUsage, memoryUsage, fps (as rendered), totalFrames, droppedFrames, congestion, outputBytes, in the units of kValueModeRaw
+			constexpr static const char* kSeriesOutputBytes = "outputBytes"; ///< bytes sent by the streaming output
+			constexpr static const char* kHistoryStart = "start"; ///< reply: ms since the epoch, where the first bucket begins
+			constexpr static const char* kHistoryStep = "step"; ///< reply: ms per bucket
+			constexpr static const char* kHistoryCount = "count"; ///< reply: array, the # of samples in each bucket (0: no data, min/max/avg are null)
+			constexpr static const char* kHistoryMin = "min";
+			constexpr static const char* kHistoryMax = "max";
+			constexpr static const char* kHistoryAvg = "avg";
+
+		/// Get/Set with parameters, not part of kValueItemNames, for scenes with any number of sources:
+		constexpr static const char* kItemSceneSourcesVisibleBits = "sourceVisibleBits"; ///< kValueItemValue: an object with the members below (Get: only kBitsScene, optional), the reply has all of them
+		constexpr static const char* kItemSceneSourcesLockBits = "sourceLockBits"; ///< the same for lock states
+			constexpr static const char* kBitsScene = "scene"; ///< String, name of the scene (default: the current scene)
+			constexpr static const char* kBitsCount = "count"; ///< Int, # of sources (Set: optional, how many of the scene's first sources the bits are for, the others are left alone)
+			constexpr static const char* kBitsData = "bits"; ///< String, base64 of the states in-order (as sortIndex), source i is bit (i % 8) of byte (i / 8)
+		constexpr static const char* kItemSceneSourcesBatch = "sourceBatch"; ///< kValueItemValue: (Set) an array of objects, one per scene, with kBitsScene and kBitsCount as above and any of the members below. Each scene's changes are applied at once, followed by one update of the scene items
+			constexpr static const char* kBatchVisibleBits = "visibleBits"; ///< String, visible states as kBitsData
+			constexpr static const char* kBatchLockBits = "lockBits"; ///< String, lock states as kBitsData
+			constexpr static const char* kBatchOrder = "order"; ///< array of the sortIndex of every source, in their new order
+
+		/// Pushed only to clients that 'subscribe' to it (kSubscribeInterval: every # ms, default 33), not part of kValueItemNames:
+		constexpr static const char* kItemAudioLevels = "audioLevels"; ///< kValueItemValue: an array with one object per audio source, its name and the level arrays below
+			constexpr static const char* kLevelMagnitude = "magnitude"; ///< dBFS per channel, the average since the previous push (floored at -96, silence)
+			constexpr static const char* kLevelPeak = "peak"; ///< dBFS per channel, the highest since the previous push
+			constexpr static const char* kLevelInputPeak = "inputPeak"; ///< dBFS per channel before the source's volume, the highest since the previous push
+			constexpr static const char* kSubscribeFormat = "format"; ///< optional with 'subscribe' to audioLevels, one of:
+				constexpr static const char* kLevelFormatJson = "json"; ///< (default) the json value above
+				constexpr static const char* kLevelFormatBinary8 = "binary8"; ///< kFrameMagicMeters frames with 8-bit levels, for v2 clients (others get json)
+				constexpr static const char* kLevelFormatBinary16 = "binary16"; ///< the same with 16-bit levels
+		
+		/// Binary audio levels, the payload of a kFrameMagicMeters frame (multi-byte values big-endian):
+		/// u8 flags (kMeterFlagWide), u8 # of channels, u8 # of sources, u32 timestamp (ms on a monotonic server clock with an arbitrary origin, wrapping; only the differences between frames are meaningful),
+		/// then per source: u8 id (see kItemAudioSources), and per channel its magnitude and peak (meaning as above),
+		/// each an unsigned level of 8 bits (16 with kMeterFlagWide): dBFS = -96 + 96 * level / 255 (65535).
+		static const unsigned char kMeterFlagWide = 0x01;
+		static const int kMeterHeaderBytes = 7;
+		constexpr static const char* kItemAudioSources = "audioSources"; ///< kValueItemValue: an array of objects with the name and id of each metered source. Sent to binary subscribers before their first frame and whenever the sources change
+			constexpr static const char* kAudioSourceId = "id"; ///< Int, 0-254, only valid until the next audioSources
+
+		/// A connection's initial state, in this order. Items added later (kItemFramesPerSecond) are left out,
+		/// so it stays what existing clients expect, they're sent when asked for or subscribed to.
 		constexpr static const char* kValueItemNames[] = 
 		{
 			kItemCPU,
@@ -138,6 +217,15 @@ namespace OBSRemoteProtocol
 			kItemTransitionCurrent,
 			kItemTransitionCurrentDuration,
 		};
+		
+		/// FNV-1a hash of a Value Item name, what the plugin dispatches on (computed at compile time for the names above)
+		constexpr unsigned int hashItemName (const char* name)
+		{
+			unsigned int hash = 2166136261u;
+			for(; *name; ++name)
+				hash = (hash ^ (unsigned char)*name) * 16777619u;
+			return hash;
+		}
 
 		/// Sources:
 		constexpr static const char* kSourceName = "name"; ///< String
@@ -26,6 +26,9 @@
 #include "networkserver.h"
 #include "networkconnection.h"
 #include "obsobjects.h"
+#include "itembits.h"
+
+#include <QJsonDocument>
 
 #include "moc_protocoladapter.cpp"
 
@@ -39,8 +42,15 @@ using namespace OBSRemoteProtocol;
 //************************************************************************************************
 
 ProtocolAdapter::ProtocolAdapter (NetworkServer& server)
-: server (server)
+: server (server),
+  flushWindowMs (0),
+  telemetry (*this),
+  metering (*this)
 {
+	flushTimer.setSingleShot (true);
+	connect (&flushTimer, &QTimer::timeout, this, &ProtocolAdapter::flush);
+	connect (&sceneDebouncer, &Debouncer::fired, this, &ProtocolAdapter::sendDebounced);
+
 	connect (&server, &NetworkServer::receivedJson, this, &ProtocolAdapter::receivedJson);
 	connect (&server, &NetworkServer::connectionAdded, this, &ProtocolAdapter::connectionAdded);
 	connect (&server, &NetworkServer::connectionRemoved, this, &ProtocolAdapter::connectionRemoved);
@@ -50,23 +60,32 @@ ProtocolAdapter::ProtocolAdapter (NetworkServer& server)
 	connect (&frontend, &FrontEnd::transitionChanged, this, &ProtocolAdapter::transitionChanged);
 	connect (&frontend, &FrontEnd::transitionListChanged, this, &ProtocolAdapter::transitionListChanged);
 	connect (&frontend, &FrontEnd::transitionStopped, this, &ProtocolAdapter::transitionStopped);
+	connect (&frontend, &FrontEnd::bulkLoadFinished, this, &ProtocolAdapter::bulkLoadFinished);
 	connect (&frontend, &FrontEnd::transitionDurationChanged, this, &ProtocolAdapter::transitionDurationChanged);
 	connect (&frontend, &FrontEnd::sceneChanged, this, &ProtocolAdapter::sceneChanged);
 	connect (&frontend, &FrontEnd::previewSceneChanged, this, &ProtocolAdapter::previewSceneChanged);
 	connect (&frontend, &FrontEnd::sceneListChanged, this, &ProtocolAdapter::sceneListChanged);
 	
-	sceneChanged (); // connect to the active scene...
+	// follow every scene in the model, the scene list reports items of all of them
+	SceneModel& sceneModel = frontend.getSceneModel ();
+	connect (&sceneModel, &SceneModel::sceneAdded, this, &ProtocolAdapter::connectScene);
+	connect (&sceneModel, &SceneModel::sceneRemoved, this, &ProtocolAdapter::disconnectScene);
+	for(auto scene : sceneModel.getScenes ())
+		connectScene (*scene);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 ProtocolAdapter::~ProtocolAdapter ()
 {
-	if(Scene* scene = frontend.getCurrentScene ())
-		disconnectScene (*scene);
-	if(Scene* scene = frontend.getPreviewScene ())
+	SceneModel& sceneModel = frontend.getSceneModel ();
+	disconnect (&sceneModel, &SceneModel::sceneAdded, this, &ProtocolAdapter::connectScene);
+	disconnect (&sceneModel, &SceneModel::sceneRemoved, this, &ProtocolAdapter::disconnectScene);
+	for(auto scene : sceneModel.getScenes ())
 		disconnectScene (*scene);
 	
+	disconnect (&flushTimer, &QTimer::timeout, this, &ProtocolAdapter::flush);
+	disconnect (&sceneDebouncer, &Debouncer::fired, this, &ProtocolAdapter::sendDebounced);
 	disconnect (&server, &NetworkServer::receivedJson, this, &ProtocolAdapter::receivedJson);
 	disconnect (&server, &NetworkServer::connectionAdded, this, &ProtocolAdapter::connectionAdded);
 	disconnect (&server, &NetworkServer::connectionRemoved, this, &ProtocolAdapter::connectionRemoved);
@@ -76,6 +95,7 @@ ProtocolAdapter::~ProtocolAdapter ()
 	disconnect (&frontend, &FrontEnd::transitionChanged, this, &ProtocolAdapter::transitionChanged);
 	disconnect (&frontend, &FrontEnd::transitionListChanged, this, &ProtocolAdapter::transitionListChanged);
 	disconnect (&frontend, &FrontEnd::transitionStopped, this, &ProtocolAdapter::transitionStopped);
+	disconnect (&frontend, &FrontEnd::bulkLoadFinished, this, &ProtocolAdapter::bulkLoadFinished);
 	disconnect (&frontend, &FrontEnd::transitionDurationChanged, this, &ProtocolAdapter::transitionDurationChanged);
 	disconnect (&frontend, &FrontEnd::sceneChanged, this, &ProtocolAdapter::sceneChanged);
 	disconnect (&frontend, &FrontEnd::previewSceneChanged, this, &ProtocolAdapter::previewSceneChanged);
@@ -99,6 +119,7 @@ void ProtocolAdapter::connectScene (Scene& scene)
 	connect (&scene, &Scene::sceneSourcesRefreshed, this, &ProtocolAdapter::sceneSourcesRefreshed);
 	connect (&scene, &Scene::sceneSourceVisibilityChanged, this, &ProtocolAdapter::sceneSourceVisibilityChanged);
 	connect (&scene, &Scene::sceneSourceLockChanged, this, &ProtocolAdapter::sceneSourceLockChanged);
+	connect (&scene, &Scene::sceneSourcesChanged, this, &ProtocolAdapter::sceneSourcesChanged);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -118,79 +139,763 @@ void ProtocolAdapter::disconnectScene (Scene& scene)
 	disconnect (&scene, &Scene::sceneSourcesRefreshed, this, &ProtocolAdapter::sceneSourcesRefreshed);
 	disconnect (&scene, &Scene::sceneSourceVisibilityChanged, this, &ProtocolAdapter::sceneSourceVisibilityChanged);
 	disconnect (&scene, &Scene::sceneSourceLockChanged, this, &ProtocolAdapter::sceneSourceLockChanged);
+	disconnect (&scene, &Scene::sceneSourcesChanged, this, &ProtocolAdapter::sceneSourcesChanged);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::setFlushWindow (int milliseconds)
+{
+	flushWindowMs = qMax (0, milliseconds);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::setSceneDebounce (int quietMs, int maxLatencyMs)
+{
+	sceneDebouncer.setQuietPeriod (quietMs);
+	sceneDebouncer.setMaxLatency (maxLatencyMs);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::send (const QJsonValue& item, NetworkConnection* connection)
 {
-	QJsonArray valuesArray;
-	valuesArray.append (item);
-	sendValues (valuesArray, connection);
+	QJsonObject object = item.toObject ();
+	queue (object.value (kValueItemName).toString (), QJsonDocument (object).toJson (QJsonDocument::Compact), connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sendItem (const QString& name, NetworkConnection* connection)
+{
+	queue (name, serializeItem (name, wantsRawValues (connection)), connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ProtocolAdapter::wantsRawValues (NetworkConnection* connection) const
+{
+	if(!connection) // broadcasts are always formatted, telemetry isn't broadcast
+		return false;
+	return clients.value (connection).rawValues;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::setValueMode (NetworkConnection& connection, const QJsonValue& value)
+{
+	ClientInfo& client = clients[&connection];
+	QString mode = value.toString ();
+	if(mode == QLatin1String (kValueModeRaw))
+		client.rawValues = true;
+	else if(mode == QLatin1String (kValueModeFormatted))
+		client.rawValues = false;
+	else
+	{
+		LOG ("ProtocolAdapter::setValueMode: unknown mode '%s'", STR (mode))
+	}
+	
+	QJsonObject item;
+	item[kValueItemName] = kItemValueMode;
+	item[kValueItemValue] = client.rawValues ? kValueModeRaw : kValueModeFormatted;
+	item[kValueItemType] = kValueItemTypeSet;
+	send (item, &connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::setFraming (NetworkConnection& connection, const QJsonValue& value)
+{
+	QString name = value.toString ();
+	NetworkFraming framing = connection.getFraming ();
+	if(name == QLatin1String (kFramingNameV2))
+		framing = kFramingV2;
+	else if(name == QLatin1String (kFramingNameLegacy))
+		framing = kLegacyFraming;
+	else
+	{
+		LOG ("ProtocolAdapter::setFraming: unknown framing '%s'", STR (name))
+	}
+	
+	// the confirmation is the first message in the new framing, queued items go out the same way.
+	// Switching to v2 resends the initial state, legacy frames may have left out some of it.
+	bool upgraded = framing == kFramingV2 && connection.getFraming () != kFramingV2;
+	connection.setFraming (framing);
+	
+	QJsonObject item;
+	item[kValueItemName] = kItemFraming;
+	item[kValueItemValue] = connection.getFraming () == kFramingV2 ? kFramingNameV2 : kFramingNameLegacy;
+	item[kValueItemType] = kValueItemTypeSet;
+	send (item, &connection);
+	
+	if(upgraded)
+		sendInitialState (connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sendStatsHistory (NetworkConnection& connection, const QJsonObject& params)
+{
+	static const int kDefaultSeconds = 600;
+	static const int kDefaultBuckets = 60;
+	static const int kMaxSeconds = StatsHistory::kCapacity * Statistics::kSampleIntervalMs / 1000;
+	
+	quint32 seriesMask = (1u << StatsHistory::kNumSeries) - 1;
+	if(params.contains (kHistorySeries))
+	{
+		seriesMask = 0;
+		for(const QJsonValue& name : params[kHistorySeries].toArray ())
+		{
+			int series = StatsHistory::findSeries (name.toString ());
+			if(series < 0)
+			{
+				LOG ("ProtocolAdapter::sendStatsHistory: unknown series '%s'", STR (name.toString ()))
+			}
+			else
+				seriesMask |= 1u << series;
+		}
+	}
+	
+	int seconds = qBound (1, params[kHistorySeconds].toInt (kDefaultSeconds), kMaxSeconds);
+	int bucketCount = qBound (1, params[kHistoryBuckets].toInt (kDefaultBuckets), StatsHistory::kMaxBuckets);
+	const StatsHistory& statsHistory = stats.getHistory ();
+	qint64 to = statsHistory.now () + 1; // up to and including now
+	qint64 from = to - qint64 (seconds) * 1000;
+	
+	StatsHistory::Range range;
+	if(!statsHistory.query (range, from, to, bucketCount, seriesMask))
+		return;
+	
+	// columnar: one array per value, rather than one object per bucket
+	QJsonObject history;
+	history[kHistoryStart] = double (statsHistory.toWallTime (range.start));
+	history[kHistoryStep] = double (range.step);
+	QJsonArray counts;
+	for(int count : range.counts)
+		counts.append (count);
+	history[kHistoryCount] = counts;
+	
+	for(int series = 0; series < StatsHistory::kNumSeries; series++)
+	{
+		if(!(seriesMask & (1u << series)))
+			continue;
+		
+		QJsonArray min, max, avg;
+		for(int bucket = 0; bucket < range.counts.size (); bucket++)
+		{
+			if(range.counts[bucket] == 0)
+			{
+				min.append (QJsonValue ());
+				max.append (QJsonValue ());
+				avg.append (QJsonValue ());
+			}
+			else
+			{
+				min.append (range.min[series][bucket]);
+				max.append (range.max[series][bucket]);
+				avg.append (range.avg[series][bucket]);
+			}
+		}
+		
+		QJsonObject values;
+		values[kHistoryMin] = min;
+		values[kHistoryMax] = max;
+		values[kHistoryAvg] = avg;
+		history[StatsHistory::getSeriesName (series)] = values;
+	}
+	
+	QJsonObject item;
+	item[kValueItemName] = kItemStatsHistory;
+	item[kValueItemValue] = history;
+	item[kValueItemType] = kValueItemTypeSet;
+	send (item, &connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+Scene* ProtocolAdapter::findBitsScene (const QJsonObject& params) const
+{
+	if(!params.contains (kBitsScene))
+		return frontend.getCurrentScene ();
+	
+	Scene* scene = frontend.getSceneModel ().findScene (params[kBitsScene].toString ());
+	if(!scene)
+	{
+		LOG ("ProtocolAdapter: unknown scene '%s'", STR (params[kBitsScene].toString ()))
+	}
+	return scene;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+ItemBits ProtocolAdapter::getSourceBits (const Scene& scene, bool locks, int count)
+{
+	const QVector<SceneSource*>& sceneSources = scene.getSources ();
+	ItemBits bits (qMin (count, sceneSources.count ()));
+	for(int index = 0; index < bits.getCount (); index++)
+		bits.set (index, locks ? sceneSources[index]->isLocked () : sceneSources[index]->isVisible ());
+	return bits;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sendSourceBits (NetworkConnection& connection, const QString& name, const QJsonObject& params)
+{
+	Scene* scene = findBitsScene (params);
+	if(!scene)
+		return;
+	
+	bool locks = name == QLatin1String (kItemSceneSourcesLockBits);
+	ItemBits bits = getSourceBits (*scene, locks, scene->getSources ().count ());
+	
+	QJsonObject value;
+	value[kBitsScene] = scene->getName ();
+	value[kBitsCount] = bits.getCount ();
+	value[kBitsData] = QString::fromLatin1 (bits.toBase64 ());
+	
+	QJsonObject item;
+	item[kValueItemName] = name;
+	item[kValueItemValue] = value;
+	item[kValueItemType] = kValueItemTypeSet;
+	send (item, &connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::setSourceBits (const QString& name, const QJsonObject& params)
+{
+	Scene* scene = findBitsScene (params);
+	if(!scene)
+		return;
+	
+	const QVector<SceneSource*>& sceneSources = scene->getSources ();
+	int count = qBound (0, params[kBitsCount].toInt (sceneSources.count ()), sceneSources.count ());
+	ItemBits requested;
+	if(!ItemBits::fromBase64 (requested, params[kBitsData].toString ().toLatin1 (), count))
+	{
+		LOG ("ProtocolAdapter::setSourceBits expected %d bits for '%s'", count, STR (scene->getName ()))
+		return;
+	}
+	
+	SceneUpdate update;
+	addSourceChanges (update, *scene, name == QLatin1String (kItemSceneSourcesLockBits), requested);
+	scene->apply (update);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::setSourceBatch (const QJsonValue& value)
+{
+	QJsonArray scenes;
+	if(value.isArray ())
+		scenes = value.toArray ();
+	else
+		scenes.append (value);
+	
+	for(const QJsonValue& i : scenes)
+	{
+		QJsonObject params = i.toObject ();
+		Scene* scene = findBitsScene (params);
+		if(!scene)
+			continue;
+		
+		// the order goes last, the bits are for the sources in their current order
+		SceneUpdate update;
+		int count = qBound (0, params[kBitsCount].toInt (scene->getSources ().count ()), scene->getSources ().count ());
+		bool valid = true;
+		ItemBits requested;
+		if(params.contains (kBatchVisibleBits))
+		{
+			if(ItemBits::fromBase64 (requested, params[kBatchVisibleBits].toString ().toLatin1 (), count))
+				addSourceChanges (update, *scene, false, requested);
+			else
+				valid = false;
+		}
+		if(params.contains (kBatchLockBits))
+		{
+			if(ItemBits::fromBase64 (requested, params[kBatchLockBits].toString ().toLatin1 (), count))
+				addSourceChanges (update, *scene, true, requested);
+			else
+				valid = false;
+		}
+		if(params.contains (kBatchOrder) && !addSourceOrder (update, *scene, params[kBatchOrder].toArray ()))
+			valid = false;
+		
+		if(!valid)
+		{
+			LOG ("ProtocolAdapter::setSourceBatch ignoring invalid changes for '%s'", STR (scene->getName ()))
+			continue;
+		}
+		scene->apply (update);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::addSourceChanges (SceneUpdate& update, const Scene& scene, bool locks, const ItemBits& requested)
+{
+	const QVector<SceneSource*>& sceneSources = scene.getSources ();
+	QVector<QPair<SceneSource*, bool>>& changes = locks ? update.locked : update.visible;
+	requested.forEachDifference (getSourceBits (scene, locks, requested.getCount ()), [&] (int index, bool state)
+	{
+		changes.append (qMakePair (sceneSources[index], state));
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ProtocolAdapter::addSourceOrder (SceneUpdate& update, const Scene& scene, const QJsonArray& order)
+{
+	// every source exactly once
+	const QVector<SceneSource*>& sceneSources = scene.getSources ();
+	if(order.count () != sceneSources.count ())
+		return false;
+	
+	QVector<bool> used (sceneSources.count (), false);
+	QVector<SceneSource*> ordered;
+	ordered.reserve (sceneSources.count ());
+	for(const QJsonValue& i : order)
+	{
+		int index = i.toInt (-1);
+		if(index < 0 || index >= sceneSources.count () || used[index])
+			return false;
+		used[index] = true;
+		ordered.append (sceneSources[index]);
+	}
+	
+	if(ordered != sceneSources)
+		update.order.swap (ordered);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::queue (const QString& name, const QByteArray& item, NetworkConnection* connection)
+{
+	// everything sent within one event loop turn (or flush window) goes out as a single 'values' array,
+	// an item sent more than once in that time is only sent with its newest value
+	OutgoingBatch& batch = outgoing[connection];
+	int index = name.isEmpty () ? -1 : batch.indexOfName.value (name, -1);
+	if(index >= 0)
+		batch.items[index] = item;
+	else
+	{
+		if(!name.isEmpty ())
+			batch.indexOfName.insert (name, batch.items.count ());
+		batch.items.append (item);
+		batch.itemBits.append (connection ? 0 : getItemBit (findItem (name))); // only broadcasts are filtered
+	}
+	
+	if(!flushTimer.isActive ())
+		flushTimer.start (flushWindowMs);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::sendValues (const QJsonArray& valuesArray, NetworkConnection* connection)
 {
-	QJsonObject object;
-	object[kValuesArray] = valuesArray;
+	for(auto item : valuesArray)
+		send (item, connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sendSceneItem (const QString& name)
+{
+	if(!pendingSceneItems.contains (name))
+		pendingSceneItems.append (name);
+	sceneDebouncer.trigger ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sendDebounced ()
+{
+	QStringList names;
+	names.swap (pendingSceneItems);
+	for(const QString& name : names)
+		sendItem (name);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::flush ()
+{
+	flushTimer.stop ();
+	
+	QHash<NetworkConnection*, OutgoingBatch> batches;
+	batches.swap (outgoing);
+	
+	// one message per connection: its replies first, then the broadcast items it's interested in,
+	// they carry the newest state. A reply the broadcast has a newer value of is left out.
+	OutgoingBatch broadcast = batches.take (nullptr);
+	QHash<quint64, QVector<NetworkConnection*>> recipients;
+	for(auto i = clients.constBegin (); i != clients.constEnd (); ++i)
+	{
+		quint64 interests = i.value ().interests;
+		auto replies = batches.constFind (i.key ());
+		if(replies == batches.constEnd ())
+		{
+			if(!broadcast.items.isEmpty ())
+				recipients[interests].append (i.key ());
+			continue;
+		}
+		
+		QVector<bool> superseded (replies->items.count (), false);
+		for(auto name = replies->indexOfName.constBegin (); name != replies->indexOfName.constEnd (); ++name)
+		{
+			int index = broadcast.indexOfName.value (name.key (), -1);
+			if(index >= 0 && isWanted (broadcast, index, interests))
+				superseded[name.value ()] = true;
+		}
+		
+		QVector<QByteArray> items;
+		for(int index = 0; index < replies->items.count (); index++)
+			if(!superseded.at (index))
+				items.append (replies->items.at (index));
+		items += selectItems (broadcast, interests);
+		deliver (items, {i.key ()});
+	}
+	
+	// connections with nothing but the broadcast share one payload per distinct set of interests
+	for(auto i = recipients.constBegin (); i != recipients.constEnd (); ++i)
+		deliver (selectItems (broadcast, i.key ()), i.value ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::deliver (const QVector<QByteArray>& items, const QVector<NetworkConnection*>& recipients)
+{
+	if(items.isEmpty () || recipients.isEmpty ())
+		return;
+	
+	// legacy frames can't describe more than kMaxPayloadBytesLegacy bytes, those clients get the items in several messages
+	QByteArray payload = buildPayload (items);
+	QVector<NetworkConnection*> whole;
+	QVector<NetworkConnection*> split;
+	for(auto connection : recipients)
+	{
+		if(payload.size () > kMaxPayloadBytesLegacy && connection->getFraming () != kFramingV2)
+			split.append (connection);
+		else
+			whole.append (connection);
+	}
+	
+	if(whole.count () == 1)
+		server.sendPayload (*whole.first (), payload);
+	else if(!whole.isEmpty ())
+		server.broadcastPayload (payload, whole);
+	
+	if(split.isEmpty ())
+		return;
+	
+	static const int envelopeSize = buildPayload (QVector<QByteArray> ()).size ();
+	int first = 0;
+	while(first < items.count ())
+	{
+		// as many items as fit, an item that doesn't fit on its own is refused
+		int size = envelopeSize + items.at (first).size ();
+		if(size > kMaxPayloadBytesLegacy)
+		{
+			LOG ("ProtocolAdapter: %d byte item can't be sent to legacy clients, they need v2 framing: %.40s", size, items.at (first).constData ())
+			first++;
+			continue;
+		}
+		
+		int count = 1;
+		while(first + count < items.count () && size + 1 + items.at (first + count).size () <= kMaxPayloadBytesLegacy)
+			size += 1 + items.at (first + count++).size ();
+		
+		QByteArray part = buildPayload (items, first, count);
+		if(split.count () == 1)
+			server.sendPayload (*split.first (), part);
+		else
+			server.broadcastPayload (part, split);
+		first += count;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
 
-	if(connection)
-		server.sendJson (*connection, object);
+QVector<QByteArray> ProtocolAdapter::selectItems (const OutgoingBatch& batch, quint64 interests)
+{
+	if(interests == kAllItems)
+		return batch.items;
+	
+	QVector<QByteArray> items;
+	items.reserve (batch.items.count ());
+	for(int i = 0; i < batch.items.count (); i++)
+		if(isWanted (batch, i, interests))
+			items.append (batch.items.at (i)); // implicitly shared, not copied
+	return items;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray ProtocolAdapter::buildPayload (const QVector<QByteArray>& items, int first, int count)
+{
+	// the items are already serialized, so is the message around them: {"values":[item,item,...]}
+	static const QByteArray prefix = QByteArray ("{\"") + kValuesArray + "\":[";
+	static const QByteArray suffix ("]}");
+	
+	if(count < 0)
+		count = items.count () - first;
+	
+	int size = prefix.size () + suffix.size () + count;
+	for(int i = first; i < first + count; i++)
+		size += items.at (i).size ();
+	
+	QByteArray payload;
+	payload.reserve (size);
+	payload.append (prefix);
+	for(int i = first; i < first + count; i++)
+	{
+		if(i > first)
+			payload.append (',');
+		payload.append (items.at (i));
+	}
+	payload.append (suffix);
+	return payload;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::subscribe (NetworkConnection& connection, const QJsonObject& item, bool state)
+{
+	QString name = item[kValueItemName].toString ();
+	if(name == QLatin1String (kItemAudioLevels)) // not a value item, only ever pushed to subscribers
+	{
+		if(state)
+			metering.subscribe (connection, item[kSubscribeInterval].toInt (AudioMetering::kDefaultIntervalMs), item[kSubscribeFormat].toString ());
+		else
+			metering.unsubscribe (connection);
+		return;
+	}
+	
+	quint64 bit = getItemBit (findItem (name));
+	if(bit == 0)
+	{
+		LOG ("ProtocolAdapter::subscribe: unknown item '%s'", STR (name))
+		return;
+	}
+	
+	// telemetry is never broadcast, it's pushed by the publisher at the client's rate,
+	// so it leaves the broadcasts the client receives alone
+	if(TelemetryPublisher::isTelemetryItem (name))
+	{
+		if(state)
+		{
+			int intervalMs = item[kSubscribeInterval].toInt (TelemetryPublisher::kDefaultIntervalMs);
+			double deadband = item.contains (kSubscribeDeadband) ? item[kSubscribeDeadband].toDouble () : -1;
+			telemetry.subscribe (connection, name, intervalMs, deadband);
+			sendItem (name, &connection);
+		}
+		else
+			telemetry.unsubscribe (connection, name);
+		return;
+	}
+	
+	ClientInfo& client = clients[&connection];
+	if(state)
+	{
+		if(!client.subscribed) // the first subscription narrows it down from everything
+		{
+			client.interests = 0;
+			client.subscribed = true;
+		}
+		client.interests |= bit;
+		sendItem (name, &connection);
+	}
 	else
-		server.broadcastJson (object);
+		client.interests &= ~bit;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QJsonValue ProtocolAdapter::set (const QString& name, const QVariant& value)
+QByteArray ProtocolAdapter::serializeItem (const QString& name, bool raw)
+{
+	if(name == kItemSceneList)
+	{
+		// same as get (), with the value spliced in from the scenes' cached json
+		QByteArray item ("{\"");
+		item.append (kValueItemName).append ("\":\"").append (kItemSceneList).append ("\",\"");
+		item.append (kValueItemType).append ("\":\"").append (kValueItemTypeSet).append ("\",\"");
+		item.append (kValueItemValue).append ("\":");
+		item.append (serializeSceneList ());
+		item.append ('}');
+		return item;
+	}
+	return QJsonDocument (get (name, raw).toObject ()).toJson (QJsonDocument::Compact);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::set (const QString& name, const QJsonValue& value)
 {
 	QJsonValue item;
-	QString methodName = buildMethodName (name, kSet);
-	//LOG ("set methodName %s", STR (methodName))
-	if(!QMetaObject::invokeMethod (this, STR (methodName), Qt::DirectConnection, Q_ARG (QVariant, value)))
+	const ItemHandler* handler = findItemHandler (name);
+	if(handler && handler->set)
+		(this->*handler->set) (value);
+	else
 	{
-		LOG ("ProtocolAdapter::set: unhandled protocol request '%s' (%s)", STR (name), STR (methodName))
+		LOG ("ProtocolAdapter::set: unhandled protocol request '%s'", STR (name))
 	}
 	return item;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QJsonValue ProtocolAdapter::get (const QString& name)
+QJsonValue ProtocolAdapter::get (const QString& name, bool raw)
 {
 	QJsonObject item;
-	QString methodName = buildMethodName (name, kGet);
-	//LOG ("get methodName %s", STR (methodName))
-	QJsonValue retVal;
-	if(QMetaObject::invokeMethod (this, STR (methodName), Qt::DirectConnection, Q_RETURN_ARG (QJsonValue, retVal)))
+	const ItemHandler* handler = findItemHandler (name);
+	if(handler && handler->get)
 	{
 		item[kValueItemName] = name;
-		item[kValueItemValue] = retVal;
+		item[kValueItemValue] = (raw && handler->getRaw) ? (this->*handler->getRaw) () : (this->*handler->get) ();
 		item[kValueItemType] = kValueItemTypeSet; // if they requested a 'get', we respond with a set
 	}
 	else 
 	{
-		LOG ("ProtocolAdapter::get: unhandled protocol request '%s' (%s)", STR (name), STR (methodName))
+		LOG ("ProtocolAdapter::get: unhandled protocol request '%s'", STR (name))
 	}
 	return item;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::getAll (QJsonArray& valuesArray)
+constexpr ProtocolAdapter::ItemHandler ProtocolAdapter::kItemHandlers[] =
+{
+	{hashItemName (kItemCPU), kItemCPU, &ProtocolAdapter::getCpuUsage, nullptr, &ProtocolAdapter::getCpuUsageRaw},
+	{hashItemName (kItemMemory), kItemMemory, &ProtocolAdapter::getMemoryUsage, nullptr, &ProtocolAdapter::getMemoryUsageRaw},
+	{hashItemName (kItemDisk), kItemDisk, &ProtocolAdapter::getFreeDisk, nullptr, &ProtocolAdapter::getFreeDiskRaw},
+	{hashItemName (kItemRecordingTime), kItemRecordingTime, &ProtocolAdapter::getRecordingTime, nullptr, &ProtocolAdapter::getRecordingTimeRaw},
+	{hashItemName (kItemStreamingTime), kItemStreamingTime, &ProtocolAdapter::getStreamingTime, nullptr, &ProtocolAdapter::getStreamingTimeRaw},
+	{hashItemName (kItemTotalFrames), kItemTotalFrames, &ProtocolAdapter::getTotalFrames, nullptr, &ProtocolAdapter::getTotalFramesRaw},
+	{hashItemName (kItemDroppedFrames), kItemDroppedFrames, &ProtocolAdapter::getDroppedFrames, nullptr, &ProtocolAdapter::getDroppedFramesRaw},
+	{hashItemName (kItemCongestion), kItemCongestion, &ProtocolAdapter::getCongestion, nullptr, &ProtocolAdapter::getCongestionRaw},
+	{hashItemName (kItemFramesPerSecond), kItemFramesPerSecond, &ProtocolAdapter::getFps, nullptr, &ProtocolAdapter::getFpsRaw},
+	
+	{hashItemName (kItemStudioMode), kItemStudioMode, &ProtocolAdapter::getStudioMode, &ProtocolAdapter::setStudioMode, nullptr},
+	{hashItemName (kItemTriggerTransition), kItemTriggerTransition, &ProtocolAdapter::getTriggerTransition, &ProtocolAdapter::setTriggerTransition, nullptr},
+	{hashItemName (kItemStreaming), kItemStreaming, &ProtocolAdapter::getStreaming, &ProtocolAdapter::setStreaming, nullptr},
+	{hashItemName (kItemRecording), kItemRecording, &ProtocolAdapter::getRecording, &ProtocolAdapter::setRecording, nullptr},
+	
+	{hashItemName (kItemSceneList), kItemSceneList, &ProtocolAdapter::getSceneList, &ProtocolAdapter::setSceneList, nullptr},
+	{hashItemName (kItemCurrentScene), kItemCurrentScene, &ProtocolAdapter::getCurrentScene, &ProtocolAdapter::setCurrentScene, nullptr},
+	{hashItemName (kItemPreviewScene), kItemPreviewScene, &ProtocolAdapter::getPreviewScene, &ProtocolAdapter::setPreviewScene, nullptr},
+	{hashItemName (kItemSceneSourcesLocks), kItemSceneSourcesLocks, &ProtocolAdapter::getSourceLocks, &ProtocolAdapter::setSourceLocks, nullptr},
+	{hashItemName (kItemSceneSourcesVisibles), kItemSceneSourcesVisibles, &ProtocolAdapter::getSourceVisibles, &ProtocolAdapter::setSourceVisibles, nullptr},
+	{hashItemName (kItemTransitionList), kItemTransitionList, &ProtocolAdapter::getTransitionsList, &ProtocolAdapter::setTransitionsList, nullptr},
+	{hashItemName (kItemTransitionCurrent), kItemTransitionCurrent, &ProtocolAdapter::getCurrentTransition, &ProtocolAdapter::setCurrentTransition, nullptr},
+	{hashItemName (kItemTransitionCurrentDuration), kItemTransitionCurrentDuration, &ProtocolAdapter::getTransitionDuration, &ProtocolAdapter::setTransitionDuration, nullptr},
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr bool ProtocolAdapter::hasItemGetter (unsigned int hash)
+{
+	for(const ItemHandler& handler : kItemHandlers)
+		if(handler.hash == hash)
+			return handler.get != nullptr;
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr bool ProtocolAdapter::hasInitialStateGetters ()
 {
-	for(int i = 0; i < ARRAY_COUNT (kValueItemNames); i++)
+	for(const char* name : kValueItemNames)
+		if(!hasItemGetter (hashItemName (name)))
+			return false;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+const ProtocolAdapter::ItemHandler* ProtocolAdapter::findItemHandler (const QString& name)
+{
+	static const QHash<unsigned int, const ItemHandler*> handlers = [] ()
 	{
-		//LOG ("getAll: %s", kValueItemNames[i])
-		QJsonValue item = get (kValueItemNames[i]);
-		if(item.isNull ())
+		QHash<unsigned int, const ItemHandler*> handlers;
+		for(const ItemHandler& handler : kItemHandlers)
 		{
-			LOG ("Warning: getAll (%s) returned NULL entry", STR (kValueItemNames[i]))
+			Q_ASSERT (!handlers.contains (handler.hash)); // give one of them another name
+			handlers.insert (handler.hash, &handler);
 		}
-		else
-			valuesArray.append (item);
+		return handlers;
+	} ();
+	
+	// same as hashItemName (), without converting the name first (item names are ascii)
+	unsigned int hash = 2166136261u;
+	for(QChar c : name)
+		hash = (hash ^ c.unicode ()) * 16777619u;
+	
+	const ItemHandler* handler = handlers.value (hash, nullptr);
+	if(handler && name != QLatin1String (handler->name))
+		return nullptr;
+	return handler;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int ProtocolAdapter::countItems ()
+{
+	static_assert (ARRAY_COUNT (kItemHandlers) <= 64, "subscriptions keep one bit per item in a quint64");
+	return ARRAY_COUNT (kItemHandlers);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* ProtocolAdapter::getItemName (int index)
+{
+	if(index < 0 || index >= countItems ())
+		return nullptr;
+	return kItemHandlers[index].name;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int ProtocolAdapter::findItem (const QString& name)
+{
+	if(const ItemHandler* handler = findItemHandler (name))
+		return int (handler - kItemHandlers);
+	return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+double ProtocolAdapter::toNumber (const QJsonValue& value, bool* ok)
+{
+	*ok = true;
+	switch(value.type ())
+	{
+	case QJsonValue::Double :
+		return value.toDouble ();
+	case QJsonValue::Bool :
+		return value.toBool () ? 1 : 0;
+	case QJsonValue::String :
+		return value.toString ().toDouble (ok);
+	default :
+		*ok = false;
+		return 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* ProtocolAdapter::typeName (const QJsonValue& value)
+{
+	switch(value.type ())
+	{
+	case QJsonValue::Null : return "null";
+	case QJsonValue::Bool : return "bool";
+	case QJsonValue::Double : return "double";
+	case QJsonValue::String : return "string";
+	case QJsonValue::Array : return "array";
+	case QJsonValue::Object : return "object";
+	default : return "undefined";
 	}
 }
 
@@ -198,18 +903,29 @@ void ProtocolAdapter::getAll (QJsonArray& valuesArray)
 
 void ProtocolAdapter::receivedJson (const QJsonObject& json, NetworkConnection& connection)
 {
-	QJsonArray getResults;
 	const QJsonArray valuesArray = json[kValuesArray].toArray ();
 	for(auto value : valuesArray) 
 	{
 		const QJsonObject item = value.toObject ();
-		RequestType requestType = (item[kValueItemType].toString ().compare (kValueItemTypeSet, Qt::CaseInsensitive) == 0) ? kSet : kGet;
+		QString type = item[kValueItemType].toString ();
+		RequestType requestType = kGet;
+		if(type.compare (kValueItemTypeSet, Qt::CaseInsensitive) == 0)
+			requestType = kSet;
+		else if(type.compare (kValueItemTypeSubscribe, Qt::CaseInsensitive) == 0)
+			requestType = kSubscribe;
+		else if(type.compare (kValueItemTypeUnsubscribe, Qt::CaseInsensitive) == 0)
+			requestType = kUnsubscribe;
 		QString name = item[kValueItemName].toString ();
 		switch(requestType)
 		{
 		case kGet :
 			{
-				getResults.append (get (name));
+				if(name == QLatin1String (kItemStatsHistory))
+					sendStatsHistory (connection, item[kValueItemValue].toObject ());
+				else if(name == QLatin1String (kItemSceneSourcesVisibleBits) || name == QLatin1String (kItemSceneSourcesLockBits))
+					sendSourceBits (connection, name, item[kValueItemValue].toObject ());
+				else
+					sendItem (name, &connection);
 				//LOG ("ProtocolAdapter::parseJson GET %s", STR (name))
 			} break;
 				
@@ -217,17 +933,51 @@ void ProtocolAdapter::receivedJson (const QJsonObject& json, NetworkConnection&
 			{
 				QJsonValue value = item[kValueItemValue];
 				//LOG ("ProtocolAdapter::parseJson SET value type %d, %d", value.type (), value.toBool ())
-				set (name, value);		 
+				if(name == QLatin1String (kItemValueMode))
+					setValueMode (connection, value);
+				else if(name == QLatin1String (kItemFraming))
+					setFraming (connection, value);
+				else if(frontend.isBulkLoading ())
+					deferSet (item);
+				else
+					applySet (name, value);
 			} break;
+				
+		case kSubscribe :
+		case kUnsubscribe :
+			subscribe (connection, item, requestType == kSubscribe);
+			break;
+			
 		default:
 			LOG ("ProtocolAdapter::receivedJson unhandled requestType %s", STR (item[kValueItemType].toString ()))
 			break;
 		}
 	}
-	
-	//LOG ("getResults count = %d", getResults.count ())
-	if(!getResults.isEmpty ())
-		sendValues (getResults, &connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::applySet (const QString& name, const QJsonValue& value)
+{
+	if(name == QLatin1String (kItemSceneSourcesVisibleBits) || name == QLatin1String (kItemSceneSourcesLockBits))
+		setSourceBits (name, value.toObject ());
+	else if(name == QLatin1String (kItemSceneSourcesBatch))
+		setSourceBatch (value);
+	else
+		set (name, value);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::deferSet (const QJsonObject& item)
+{
+	// the scenes they name are being torn down or aren't there yet, bulkLoadFinished () applies them
+	if(deferredSets.count () >= kMaxDeferredSets)
+	{
+		LOG ("ProtocolAdapter::deferSet: dropping '%s', too many requests while loading", STR (item[kValueItemName].toString ()))
+		return;
+	}
+	deferredSets.append (item);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -235,15 +985,27 @@ void ProtocolAdapter::receivedJson (const QJsonObject& json, NetworkConnection&
 void ProtocolAdapter::connectionAdded (NetworkConnection& connection)
 {
 	LOG ("ProtocolAdapter::connectionAdded")
-	QJsonArray valuesArray;
-	getAll (valuesArray);
-	sendValues (valuesArray, &connection);
+	clients.insert (&connection, ClientInfo ());
+	sendInitialState (connection); // in legacy framing, v2 clients ask for it again, see setFraming ()
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sendInitialState (NetworkConnection& connection)
+{
+	static_assert (hasInitialStateGetters (), "every item of the initial state needs a getter in kItemHandlers");
+	for(const char* name : kValueItemNames)
+		sendItem (name, &connection);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::connectionRemoved (NetworkConnection& connection)
 {
+	outgoing.remove (&connection);
+	clients.remove (&connection);
+	telemetry.removeClient (connection);
+	metering.removeClient (connection);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -258,7 +1020,7 @@ void ProtocolAdapter::sceneDestroyed (const Source& source)
 void ProtocolAdapter::sceneRemoved (const Source& source)
 {
 	LOG ("Scene Removed: %s", STR (source.getName ()))
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -287,7 +1049,7 @@ void ProtocolAdapter::sceneEnabled (const Source& source, bool isEnabled)
 void ProtocolAdapter::sceneRenamed (const Source& source)
 {
 	LOG ("Scene Renamed: %s", STR (source.getName ()))
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -295,7 +1057,7 @@ void ProtocolAdapter::sceneRenamed (const Source& source)
 void ProtocolAdapter::sceneSourceAdded (const Scene& scene, const SceneSource& source)
 {
 	LOG ("Scene Source Added: %s", STR (source.getName ()))
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -303,7 +1065,7 @@ void ProtocolAdapter::sceneSourceAdded (const Scene& scene, const SceneSource& s
 void ProtocolAdapter::sceneSourceRemoved (const Scene& scene, const SceneSource& source)
 {
 	LOG ("Scene Source Removed: %s", STR (source.getName ()))
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -311,7 +1073,7 @@ void ProtocolAdapter::sceneSourceRemoved (const Scene& scene, const SceneSource&
 void ProtocolAdapter::sceneSourcesReordered (const Scene& scene)
 {
 	LOG ("Scene Source Reordered")
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -319,7 +1081,7 @@ void ProtocolAdapter::sceneSourcesReordered (const Scene& scene)
 void ProtocolAdapter::sceneSourcesRefreshed (const Scene& scene)
 {
 	LOG ("Scene Source Refreshed")
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -327,8 +1089,8 @@ void ProtocolAdapter::sceneSourcesRefreshed (const Scene& scene)
 void ProtocolAdapter::sceneSourceVisibilityChanged (const Scene& scene, const SceneSource& source, bool visible)
 {
 	LOG ("Scene Source Visibilty Changed: %s", STR (source.getName ()))
-	send (get (OBSRemoteProtocol::kItemSceneList));
-	send (get (OBSRemoteProtocol::kItemSceneSourcesVisibles));
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
+	sendSceneItem (OBSRemoteProtocol::kItemSceneSourcesVisibles);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -336,8 +1098,18 @@ void ProtocolAdapter::sceneSourceVisibilityChanged (const Scene& scene, const Sc
 void ProtocolAdapter::sceneSourceLockChanged (const Scene& scene, const SceneSource& source, bool locked)
 {
 	LOG ("Scene Source Lock changed: %s", STR (source.getName ()))
-	send (get (OBSRemoteProtocol::kItemSceneList));
-	send (get (OBSRemoteProtocol::kItemSceneSourcesLocks));
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
+	sendSceneItem (OBSRemoteProtocol::kItemSceneSourcesLocks);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ProtocolAdapter::sceneSourcesChanged (const Scene& scene)
+{
+	LOG ("Scene Sources Changed: %s", STR (scene.getName ()))
+	sendSceneItem (OBSRemoteProtocol::kItemSceneList);
+	sendSceneItem (OBSRemoteProtocol::kItemSceneSourcesVisibles);
+	sendSceneItem (OBSRemoteProtocol::kItemSceneSourcesLocks);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -345,98 +1117,101 @@ void ProtocolAdapter::sceneSourceLockChanged (const Scene& scene, const SceneSou
 void ProtocolAdapter::transitionDurationChanged ()
 {
 	LOG ("transitionDurationChanged (%d)", frontend.getTransitionDuration ())
-	send (get (OBSRemoteProtocol::kItemTransitionCurrentDuration));
-	send (get (OBSRemoteProtocol::kItemTransitionList));
+	sendItem (OBSRemoteProtocol::kItemTransitionCurrentDuration);
+	sendItem (OBSRemoteProtocol::kItemTransitionList);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::streamingStateChanged (bool isStreaming)
 {
-	send (get (OBSRemoteProtocol::kItemStreaming));
+	sendItem (OBSRemoteProtocol::kItemStreaming);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::recordingStateChanged (bool isRecording)
 {
-	send (get (OBSRemoteProtocol::kItemRecording));
+	sendItem (OBSRemoteProtocol::kItemRecording);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::studioModeChanged (bool isStudioMode)
 {
-	send (get (OBSRemoteProtocol::kItemStudioMode));
-	send (get (OBSRemoteProtocol::kItemSceneList));
-	send (get (OBSRemoteProtocol::kItemCurrentScene));
-	send (get (OBSRemoteProtocol::kItemPreviewScene));
+	sendItem (OBSRemoteProtocol::kItemStudioMode);
+	sendItem (OBSRemoteProtocol::kItemSceneList);
+	sendItem (OBSRemoteProtocol::kItemCurrentScene);
+	sendItem (OBSRemoteProtocol::kItemPreviewScene);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::sceneListChanged ()
 {
-	send (get (OBSRemoteProtocol::kItemSceneList));
+	sendItem (OBSRemoteProtocol::kItemSceneList);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::sceneChanged ()
 {
-	if(Scene* scene = frontend.getCurrentScene ())
-		connectScene (*scene);
-	send (get (OBSRemoteProtocol::kItemSceneList));
-	send (get (OBSRemoteProtocol::kItemCurrentScene));
+	sendItem (OBSRemoteProtocol::kItemSceneList);
+	sendItem (OBSRemoteProtocol::kItemCurrentScene);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::previewSceneChanged ()
 {
-	if(Scene* scene = frontend.getPreviewScene ())
-		connectScene (*scene);
-	send (get (OBSRemoteProtocol::kItemSceneList));
-	send (get (OBSRemoteProtocol::kItemCurrentScene));
-	send (get (OBSRemoteProtocol::kItemPreviewScene));
+	sendItem (OBSRemoteProtocol::kItemSceneList);
+	sendItem (OBSRemoteProtocol::kItemCurrentScene);
+	sendItem (OBSRemoteProtocol::kItemPreviewScene);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::transitionChanged ()
 {
-	send (get (OBSRemoteProtocol::kItemTransitionList));
+	sendItem (OBSRemoteProtocol::kItemTransitionList);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::transitionListChanged ()
 {
-	send (get (OBSRemoteProtocol::kItemTransitionList));
+	sendItem (OBSRemoteProtocol::kItemTransitionList);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void ProtocolAdapter::transitionStopped ()
 {
-	send (get (OBSRemoteProtocol::kItemTriggerTransition));
+	sendItem (OBSRemoteProtocol::kItemTriggerTransition);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QString ProtocolAdapter::buildMethodName (const QString& name, RequestType requestType)
-{
-	// ie., The goal here is to turn a protocol string ('currentScene') into a method name ('getCurrentScene')
-	QString methodName = name.left (1).toUpper () + name.mid (1); 
+void ProtocolAdapter::bulkLoadFinished ()
+{
+	// sent in one go, they're batched into a single message
+	LOG ("ProtocolAdapter::bulkLoadFinished")
+	pendingSceneItems.clear ();
+	sceneDebouncer.cancel ();
+	sendItem (OBSRemoteProtocol::kItemSceneList);
+	sendItem (OBSRemoteProtocol::kItemCurrentScene);
+	sendItem (OBSRemoteProtocol::kItemPreviewScene);
+	sendItem (OBSRemoteProtocol::kItemSceneSourcesVisibles);
+	sendItem (OBSRemoteProtocol::kItemSceneSourcesLocks);
+	sendItem (OBSRemoteProtocol::kItemTransitionList);
+	sendItem (OBSRemoteProtocol::kItemTransitionCurrent);
+	sendItem (OBSRemoteProtocol::kItemTransitionCurrentDuration);
 	
-	switch(requestType)
-	{
-	case kGet :
-		return kValueItemTypeGet + methodName;
-	case kSet :
-		return kValueItemTypeSet + methodName;
-	}
-	return "";
+	// in the order they came in, against the new collection
+	QVector<QJsonObject> deferred;
+	deferred.swap (deferredSets);
+	for(const QJsonObject& item : deferred)
+		applySet (item[kValueItemName].toString (), item[kValueItemValue]);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -550,40 +1325,94 @@ QJsonValue ProtocolAdapter::getFps () const
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+QJsonValue ProtocolAdapter::getCpuUsageRaw () const
+{
+	return stats.getSample ().cpuUsage;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getMemoryUsageRaw () const
+{
+	return double (stats.getSample ().residentBytes);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getFreeDiskRaw () const
+{
+	return double (stats.getSample ().freeDiskBytes);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getRecordingTimeRaw () const
+{
+	Output* output = frontend.getRecordingOutput ();
+	return double (output ? output->getTimeNanos () : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getStreamingTimeRaw () const
+{
+	Output* output = frontend.getStreamingOutput ();
+	return double (output ? output->getTimeNanos () : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getTotalFramesRaw () const
+{
+	Output* output = frontend.getStreamingOutput ();
+	return output ? output->getTotalFrames () : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getDroppedFramesRaw () const
+{
+	Output* output = frontend.getStreamingOutput ();
+	return output ? output->getDroppedFrames () : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getCongestionRaw () const
+{
+	Output* output = frontend.getStreamingOutput ();
+	return output ? output->getCongestion () * 100. : 0.;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QJsonValue ProtocolAdapter::getFpsRaw () const
+{
+	Output* output = frontend.getStreamingOutput ();
+	return output ? output->getFramesPerSecond () : 0.;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
 QJsonValue ProtocolAdapter::getSceneList () const
 {
 	LOG ("getScenelist:")
 	
-	QVector<Scene*> scenes;
-	Enumerators::Scenes enumerator (scenes);
+	const QVector<Scene*>& scenes = frontend.getSceneModel ().getScenes ();
 	
 	QJsonArray scenesArray;
 	int sortIndex = 0;
-	Scene* previewScene = frontend.getPreviewScene ();
-	Scene* currentScene = frontend.getCurrentScene ();
-	bool studioMode = frontend.isStudioMode ();
+	Scene* activeScene = frontend.isStudioMode () ? frontend.getPreviewScene () : frontend.getCurrentScene ();
 	for(auto i : scenes)
 	{
 		QJsonObject scene = i->toJson ();
 		scene[OBSRemoteProtocol::kSourceSortIndex] = sortIndex;
-		bool isCurrent = false;
-		if(studioMode)
-		{
-			if(previewScene && i->getInternal () == previewScene->getInternal ())
-				isCurrent = true;
-		}
-		else
-		{	
-			if(currentScene && i->getInternal () == currentScene->getInternal ())
-				isCurrent = true;
-		}
+		bool isCurrent = i == activeScene;
 		scene[kSourceIsCurrent] = isCurrent;
 		
 		LOG ("\t%s %s", STR (i->getName ()), isCurrent ? "[CURRENT]" : "")
 		
-		// embed each scene's items, as well.
-		scene[OBSRemoteProtocol::kSceneSourcesList] = getSceneSourceList (*i);
-		scenesArray.push_back (scene);
+		scenesArray.push_back (scene); // embeds each scene's items, as well.
 		
 		sortIndex++;
 	}
@@ -598,20 +1427,17 @@ QJsonValue ProtocolAdapter::getSourceVisibles () const
 	if(!currentScene)
 		return "";
 	
+	// only the first 32 fit, kItemSceneSourcesVisibleBits has them all
 	const QVector<SceneSource*>& sceneSources = currentScene->getSources ();
-	int index = -1;
-	int bits = 0;
-	for(auto i : sceneSources)
+	quint32 bits = 0;
+	for(int index = 0; index < qMin (sceneSources.count (), kMaxMaskBits); index++)
 	{
-		index++;
-		if(i->isVisible ()) 
-			bits |= (1<<index); 
-		else
-			bits &= ~(1<<index); 
+		if(sceneSources[index]->isVisible ()) 
+			bits |= (1u<<index); 
 	}
 	LOG ("getSourceVisibles sending %d", bits)
 
-	return bits;
+	return qint32 (bits); // as before, the 32nd source is the sign
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -623,19 +1449,15 @@ QJsonValue ProtocolAdapter::getSourceLocks () const
 		return "";
 	
 	const QVector<SceneSource*>& sceneSources = currentScene->getSources ();
-	int index = -1;
-	int bits = 0;
-	for(auto i : sceneSources)
+	quint32 bits = 0;
+	for(int index = 0; index < qMin (sceneSources.count (), kMaxMaskBits); index++)
 	{
-		index++;
-		if(i->isLocked ()) 
-			bits |= (1<<index); 
-		else
-			bits &= ~(1<<index); 
+		if(sceneSources[index]->isLocked ()) 
+			bits |= (1u<<index); 
 	}
 	
 	LOG ("getSourceLocks sending %d", bits)
-	return bits;
+	return qint32 (bits);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -660,22 +1482,39 @@ QJsonValue ProtocolAdapter::getPreviewScene () const
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-QJsonValue ProtocolAdapter::getSceneSourceList (const Scene& parentScene) const
+QByteArray ProtocolAdapter::serializeSceneList () const
 {
-	//LOG ("getSceneSourceList")
+	// only scenes that changed since the last time are serialized again,
+	// each cached object is reopened to add what depends on the list as a whole
+	const QVector<Scene*>& scenes = frontend.getSceneModel ().getScenes ();
+	Scene* activeScene = frontend.isStudioMode () ? frontend.getPreviewScene () : frontend.getCurrentScene ();
+	static const QByteArray sortIndexKey = QByteArray ("\"") + kSourceSortIndex + "\":";
+	static const QByteArray isCurrentKey = QByteArray (",\"") + kSourceIsCurrent + "\":";
 	
-	QJsonArray items;
+	QByteArray list ("[");
 	int sortIndex = 0;
-	const QVector<SceneSource*> sceneSources = parentScene.getSources ();
-	for(auto i : sceneSources)
+	for(auto i : scenes)
 	{
-		QJsonObject sceneSource = i->toJson ();
-		sceneSource[OBSRemoteProtocol::kSourceSortIndex] = sortIndex;
-		items.push_back (sceneSource);
+		if(sortIndex > 0)
+			list.append (',');
+		
+		// every scene gets an entry, so sortIndex stays equal to its index in the list
+		const QByteArray& scene = i->getSerialized ();
+		if(scene.size () > 2)
+		{
+			list.append (scene.constData (), scene.size () - 1); // without the closing brace
+			list.append (',');
+		}
+		else
+			list.append ('{'); // empty or no serialization, the entry only carries the list fields
+		list.append (sortIndexKey).append (QByteArray::number (sortIndex));
+		list.append (isCurrentKey).append (i == activeScene ? "true" : "false");
+		list.append ('}');
 		
 		sortIndex++;
 	}
-	return items;
+	list.append (']');
+	return list;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -724,52 +1563,52 @@ QJsonValue ProtocolAdapter::getTransitionDuration () const
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setStudioMode (const QVariant& value)
+void ProtocolAdapter::setStudioMode (const QJsonValue& value)
 {
 	bool ok = false;
-	double doubleVal = value.toDouble (&ok);
+	double doubleVal = toNumber (value, &ok);
 	if(!ok)
 	{
-		LOG ("setStudioMode expected Integer, got %s", value.typeName ())
+		LOG ("setStudioMode expected Integer, got %s", typeName (value))
 		return;
 	}
-	//LOG ("setStudiomode %.2f type %s", doubleVal, value.typeName ())
+	//LOG ("setStudiomode %.2f type %s", doubleVal, typeName (value))
 	frontend.setStudioMode (doubleVal > 0);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setStreaming (const QVariant& value)
+void ProtocolAdapter::setStreaming (const QJsonValue& value)
 {
 	bool ok = false;
-	double doubleVal = value.toDouble (&ok);
+	double doubleVal = toNumber (value, &ok);
 	if(!ok)
 	{
-		LOG ("setStreaming expected Integer, got %s", value.typeName ())
+		LOG ("setStreaming expected Integer, got %s", typeName (value))
 		return;
 	}
-	//LOG ("setStreaming %.2f type %s", doubleVal, value.typeName ())
+	//LOG ("setStreaming %.2f type %s", doubleVal, typeName (value))
 	frontend.setStreaming (doubleVal > 0);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setRecording (const QVariant& value)
+void ProtocolAdapter::setRecording (const QJsonValue& value)
 {
 	bool ok = false;
-	double doubleVal = value.toDouble (&ok);
+	double doubleVal = toNumber (value, &ok);
 	if(!ok)
 	{
-		LOG ("setRecording expected Integer, got %s", value.typeName ())
+		LOG ("setRecording expected Integer, got %s", typeName (value))
 		return;
 	}
-	//LOG ("setRecording %.2f type %s", doubleVal, value.typeName ())
+	//LOG ("setRecording %.2f type %s", doubleVal, typeName (value))
 	frontend.setRecording (doubleVal > 0);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setSceneList (const QVariant& value)
+void ProtocolAdapter::setSceneList (const QJsonValue& value)
 {
 	if(frontend.isStudioMode ())
 		setPreviewScene (value);
@@ -779,7 +1618,7 @@ void ProtocolAdapter::setSceneList (const QVariant& value)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setCurrentScene (const QVariant& value)
+void ProtocolAdapter::setCurrentScene (const QJsonValue& value)
 {
 	QString sceneName = value.toString ();
 	LOG ("ProtocolAdapter::setCurrentScene: %s", STR (sceneName))
@@ -788,7 +1627,7 @@ void ProtocolAdapter::setCurrentScene (const QVariant& value)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setPreviewScene (const QVariant& value)
+void ProtocolAdapter::setPreviewScene (const QJsonValue& value)
 {
 	QString sceneName = value.toString ();
 	LOG ("ProtocolAdapter::setPreviewScene: %s", STR (sceneName))
@@ -797,63 +1636,61 @@ void ProtocolAdapter::setPreviewScene (const QVariant& value)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setSourceLocks (const QVariant& value)
+void ProtocolAdapter::setSourceLocks (const QJsonValue& value)
 {
 	bool ok = false;
-	quint32 bits = value.toInt (&ok);
+	quint32 bits = quint32 (qint64 (toNumber (value, &ok)));
 	if(!ok)
 	{
-		LOG ("setSourceLocks expected int, got %s", value.typeName ())
+		LOG ("setSourceLocks expected int, got %s", typeName (value))
 		return;
 	}
-	LOG ("setSourceLocks %d type %s", bits, value.typeName ())
+	LOG ("setSourceLocks %d type %s", bits, typeName (value))
 	
 	Scene* currentScene = frontend.getCurrentScene ();
 	if(!currentScene)
 		return;
 	
-	const QVector<SceneSource*>& sceneSources = currentScene->getSources ();
-	int index = -1;
-	for(auto i : sceneSources)
-	{
-		index++;
-		bool isLocked = (bits & (1<<index)) != 0;
-		if(i->isLocked () != isLocked)
-			i->setLocked (isLocked);
-	}
+	// the sources past the first 32 aren't in the mask, they're left alone
+	ItemBits requested (qMin (currentScene->getSources ().count (), kMaxMaskBits));
+	for(int index = 0; index < requested.getCount (); index++)
+		requested.set (index, (bits & (1u<<index)) != 0);
+	
+	SceneUpdate update;
+	addSourceChanges (update, *currentScene, true, requested);
+	currentScene->apply (update);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setSourceVisibles (const QVariant& value)
+void ProtocolAdapter::setSourceVisibles (const QJsonValue& value)
 {
 	bool ok = false;
-	quint32 bits = value.toInt (&ok);
+	quint32 bits = quint32 (qint64 (toNumber (value, &ok)));
 	if(!ok)
 	{
-		LOG ("setSourceVisibles expected int, got %s", value.typeName ())
+		LOG ("setSourceVisibles expected int, got %s", typeName (value))
 		return;
 	}
-	LOG ("setSourceVisibles %d type %s", bits, value.typeName ())
+	LOG ("setSourceVisibles %d type %s", bits, typeName (value))
 	
 	Scene* currentScene = frontend.getCurrentScene ();
 	if(!currentScene)
 		return;
 	
-	const QVector<SceneSource*>& sceneSources = currentScene->getSources ();
-	int index = -1;
-	for(auto i : sceneSources)
-	{
-		index++;
-		bool isVisible = (bits & (1<<index)) != 0;
-		if(i->isVisible () != isVisible)
-			i->setVisible (isVisible);
-	}
+	// the sources past the first 32 aren't in the mask, they're left alone
+	ItemBits requested (qMin (currentScene->getSources ().count (), kMaxMaskBits));
+	for(int index = 0; index < requested.getCount (); index++)
+		requested.set (index, (bits & (1u<<index)) != 0);
+	
+	SceneUpdate update;
+	addSourceChanges (update, *currentScene, false, requested);
+	currentScene->apply (update);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setTriggerTransition (const QVariant& value)
+void ProtocolAdapter::setTriggerTransition (const QJsonValue& value)
 {
 	LOG ("setTriggerTransition")
 	frontend.startTransition ();
@@ -861,14 +1698,14 @@ void ProtocolAdapter::setTriggerTransition (const QVariant& value)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setCurrentTransition (const QVariant& value)
+void ProtocolAdapter::setCurrentTransition (const QJsonValue& value)
 {
 	frontend.setCurrentTransition (value.toString ());
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setTransitionsList (const QVariant& value)
+void ProtocolAdapter::setTransitionsList (const QJsonValue& value)
 {
 	LOG	("setTransitionsList")
 	setCurrentTransition (value);
@@ -876,15 +1713,15 @@ void ProtocolAdapter::setTransitionsList (const QVariant& value)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProtocolAdapter::setTransitionDuration (const QVariant& value)
+void ProtocolAdapter::setTransitionDuration (const QJsonValue& value)
 {
 	bool ok = false;
-	int duration = value.toInt (&ok);
+	int duration = int (toNumber (value, &ok));
 	if(!ok)
 	{
-		LOG ("setCurrentTransitionDuration expected integer, got %s", value.typeName ())
+		LOG ("setCurrentTransitionDuration expected integer, got %s", typeName (value))
 		return;
 	}
-	//LOG ("setCurrentTransitionDuration: %d type %s", duration, value.typeName ())
+	//LOG ("setCurrentTransitionDuration: %d type %s", duration, typeName (value))
 	frontend.setTransitionDuration (duration);
 }
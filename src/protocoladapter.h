@@ -26,17 +26,26 @@
 #include "obsremoteprotocol.h"
 #include "statistics.h"
 #include "frontend.h"
+#include "debouncer.h"
+#include "telemetrypublisher.h"
+#include "audiometering.h"
 
 #include <QtCore/QObject>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QVariant>
+#include <QHash>
+#include <QTimer>
+#include <QStringList>
+#include <QVector>
+#include <QByteArray>
 
 class NetworkServer;
 class NetworkConnection;
 class Source;
 class Scene;
 class SceneSource;
+class ItemBits;
+struct SceneUpdate;
 
 //************************************************************************************************
 // ProtocolAdapter
@@ -50,13 +59,18 @@ public:
 	~ProtocolAdapter ();
 	
 	void sendValues (const QJsonArray& valuesArray, NetworkConnection* connection = 0);
-	void send (const QJsonValue& item, NetworkConnection* connection = 0);
+	void send (const QJsonValue& item, NetworkConnection* connection = 0); ///< batched, see flush ()
+	void sendItem (const QString& name, NetworkConnection* connection = 0); ///< same as send (get (name)), but uses cached serializations where there are any
+	void setFlushWindow (int milliseconds); ///< 0 (the default) flushes at the end of the current event loop turn
+	void setSceneDebounce (int quietMs, int maxLatencyMs); ///< how scene item changes are collapsed, see Debouncer
 	
-	void getAll (QJsonArray& valuesArray);
-	QJsonValue get (const QString& name);
-	QJsonValue set (const QString& name, const QVariant& value);
+	QJsonValue get (const QString& name, bool raw = false); ///< raw: see OBSRemoteProtocol::kValueModeRaw
+	QJsonValue set (const QString& name, const QJsonValue& value);
+	
+	static int countItems (); ///< every Value Item the adapter handles, see getItemName ()
+	static const char* getItemName (int index);
+	static int findItem (const QString& name); ///< index of the item, or -1
 	
-public slots:
 	// Protocol:
 	QJsonValue getCpuUsage () const;
 	QJsonValue getMemoryUsage () const;
@@ -80,18 +94,33 @@ public slots:
 	QJsonValue getDroppedFrames () const;
 	QJsonValue getCongestion () const;
 	
-	void setStudioMode (const QVariant& value);
-	void setStreaming (const QVariant& value);
-	void setRecording (const QVariant& value);
-	void setSceneList (const QVariant& value);
-	void setCurrentScene (const QVariant& value);
-	void setPreviewScene (const QVariant& value);
-	void setSourceLocks (const QVariant& value);
-	void setSourceVisibles (const QVariant& value);
-	void setTransitionsList (const QVariant& value);
-	void setTriggerTransition (const QVariant& value);
-	void setCurrentTransition (const QVariant& value);
-	void setTransitionDuration (const QVariant& value);	
+	// Protocol, raw value mode:
+	QJsonValue getCpuUsageRaw () const;
+	QJsonValue getMemoryUsageRaw () const;
+	QJsonValue getFreeDiskRaw () const;
+	QJsonValue getRecordingTimeRaw () const;
+	QJsonValue getStreamingTimeRaw () const;
+	QJsonValue getTotalFramesRaw () const;
+	QJsonValue getFpsRaw () const;
+	QJsonValue getDroppedFramesRaw () const;
+	QJsonValue getCongestionRaw () const;
+	
+	void setStudioMode (const QJsonValue& value);
+	void setStreaming (const QJsonValue& value);
+	void setRecording (const QJsonValue& value);
+	void setSceneList (const QJsonValue& value);
+	void setCurrentScene (const QJsonValue& value);
+	void setPreviewScene (const QJsonValue& value);
+	void setSourceLocks (const QJsonValue& value);
+	void setSourceVisibles (const QJsonValue& value);
+	void setTransitionsList (const QJsonValue& value);
+	void setTriggerTransition (const QJsonValue& value);
+	void setCurrentTransition (const QJsonValue& value);
+	void setTransitionDuration (const QJsonValue& value);
+	
+public slots:
+	void flush (); ///< sends everything batched so far, one message per connection
+	void sendDebounced (); ///< sends the items collected by sendSceneItem ()
 	
 	// NetworkConnection:
 	void receivedJson (const QJsonObject& json, NetworkConnection& connection);
@@ -106,6 +135,7 @@ public slots:
 	void transitionDurationChanged ();
 	void transitionListChanged ();
 	void transitionStopped ();
+	void bulkLoadFinished ();
 	void sceneChanged ();
 	void previewSceneChanged ();
 	void sceneListChanged ();
@@ -121,19 +151,93 @@ public slots:
 	void sceneSourcesRefreshed (const Scene& scene);
 	void sceneSourceVisibilityChanged (const Scene& scene, const SceneSource& source, bool visible);
 	void sceneSourceLockChanged (const Scene& scene, const SceneSource& source, bool locked);
+	void sceneSourcesChanged (const Scene& scene);
 	
 protected:
+	friend class TelemetryPublisher;
+	
 	enum RequestType
 	{
 		kSet = 0,
-		kGet
+		kGet,
+		kSubscribe,
+		kUnsubscribe
+	};
+	
+	static constexpr quint64 kAllItems = ~quint64 (0);
+	static constexpr int kMaxMaskBits = 32; ///< sources in the sourceVisibles/sourceLocks masks
+	static constexpr int kMaxDeferredSets = 64; ///< set requests held while a scene collection or profile loads, see deferSet ()
+	static quint64 getItemBit (int index) { return index >= 0 ? (quint64 (1) << index) : 0; } ///< 0 for items outside the table, they go to everyone
+	
+	/** What the adapter keeps per connection. */
+	struct ClientInfo
+	{
+		quint64 interests = kAllItems; ///< item bits (see getItemBit ()) broadcast to the client, all of them until it subscribes to one
+		bool subscribed = false; ///< has subscribed to a broadcast item (telemetry doesn't count)
+		bool rawValues = false; ///< see OBSRemoteProtocol::kItemValueMode
 	};
-	static QString buildMethodName (const QString& name, RequestType requestType);
-	QJsonValue getSceneSourceList (const Scene& parentScene) const;
+	
+	/** Dispatch entry of one Value Item, keyed by OBSRemoteProtocol::hashItemName (). */
+	struct ItemHandler
+	{
+		unsigned int hash;
+		const char* name;
+		QJsonValue (ProtocolAdapter::*get) () const; ///< null for set-only items
+		void (ProtocolAdapter::*set) (const QJsonValue& value); ///< null for get-only items
+		QJsonValue (ProtocolAdapter::*getRaw) () const; ///< null if get () is the same in both value modes
+	};
+	static const ItemHandler kItemHandlers[];
+	static const ItemHandler* findItemHandler (const QString& name);
+	static constexpr bool hasItemGetter (unsigned int hash); ///< compile time, for names hashed by OBSRemoteProtocol::hashItemName ()
+	static constexpr bool hasInitialStateGetters (); ///< compile time, every item of OBSRemoteProtocol::kValueItemNames has a getter in kItemHandlers
+	static double toNumber (const QJsonValue& value, bool* ok);
+	static const char* typeName (const QJsonValue& value);
+	
+	QByteArray serializeItem (const QString& name, bool raw = false);
+	void sendInitialState (NetworkConnection& connection);
+	bool wantsRawValues (NetworkConnection* connection) const;
+	void setValueMode (NetworkConnection& connection, const QJsonValue& value);
+	void setFraming (NetworkConnection& connection, const QJsonValue& value); ///< see OBSRemoteProtocol::kItemFraming
+	void sendStatsHistory (NetworkConnection& connection, const QJsonObject& params); ///< see OBSRemoteProtocol::kItemStatsHistory
+	void sendSourceBits (NetworkConnection& connection, const QString& name, const QJsonObject& params); ///< see OBSRemoteProtocol::kItemSceneSourcesVisibleBits
+	void applySet (const QString& name, const QJsonValue& value);
+	void deferSet (const QJsonObject& item); ///< until bulkLoadFinished ()
+	void setSourceBits (const QString& name, const QJsonObject& params);
+	void setSourceBatch (const QJsonValue& value); ///< see OBSRemoteProtocol::kItemSceneSourcesBatch
+	Scene* findBitsScene (const QJsonObject& params) const;
+	static ItemBits getSourceBits (const Scene& scene, bool locks, int count); ///< of the scene's first count sources
+	static void addSourceChanges (SceneUpdate& update, const Scene& scene, bool locks, const ItemBits& requested); ///< for the sources whose state differs from requested
+	static bool addSourceOrder (SceneUpdate& update, const Scene& scene, const QJsonArray& order);
+	QByteArray serializeSceneList () const; ///< same as getSceneList (), assembled from each scene's cached json
 	void connectScene (Scene& scene);
 	void disconnectScene (Scene& scene);
+	void sendSceneItem (const QString& name); ///< debounced sendItem () for scene graph changes
+	
+	/** Items waiting to be sent to one connection (or to everyone), newest value per item name. */
+	struct OutgoingBatch
+	{
+		QVector<QByteArray> items; ///< compact json of each item
+		QVector<quint64> itemBits; ///< getItemBit () of each item
+		QHash<QString, int> indexOfName; ///< position of each named item in items
+	};
+	
+	void queue (const QString& name, const QByteArray& item, NetworkConnection* connection);
+	static bool isWanted (const OutgoingBatch& batch, int index, quint64 interests) { return batch.itemBits.at (index) == 0 || (batch.itemBits.at (index) & interests) != 0; }
+	static QVector<QByteArray> selectItems (const OutgoingBatch& batch, quint64 interests = kAllItems); ///< the batch's items the interests ask for
+	static QByteArray buildPayload (const QVector<QByteArray>& items, int first = 0, int count = -1); ///< {"values":[...]} with count items from first (-1: all of them)
+	void deliver (const QVector<QByteArray>& items, const QVector<NetworkConnection*>& recipients); ///< as one message, split into several for legacy clients that can't take it
+	void subscribe (NetworkConnection& connection, const QJsonObject& item, bool state);
 	
 	NetworkServer& server;
 	Statistics stats;
 	FrontEnd frontend;
+	QHash<NetworkConnection*, OutgoingBatch> outgoing; ///< the null connection collects broadcasts
+	QHash<NetworkConnection*, ClientInfo> clients;
+	TelemetryPublisher telemetry;
+	AudioMetering metering;
+	QTimer flushTimer;
+	int flushWindowMs;
+	Debouncer sceneDebouncer;
+	QStringList pendingSceneItems; ///< items to send when sceneDebouncer fires, in order of first request
+	QVector<QJsonObject> deferredSets; ///< set requests received while loading, see deferSet ()
 };
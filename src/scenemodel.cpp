@@ -0,0 +1,268 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : scenemodel.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Long-lived model of the scene graph, kept current from OBS signals
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#include "scenemodel.h"
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "moc_scenemodel.cpp"
+
+//************************************************************************************************
+// SceneModel
+//************************************************************************************************
+
+SceneModel::SceneModel ()
+: synchronizePending (false),
+  suspended (false)
+{
+	if(signal_handler_t* handler = obs_get_signal_handler ())
+	{
+		signal_handler_connect (handler, "source_create", onSourceCreated, this);
+		signal_handler_connect (handler, "source_remove", onSourceRemoved, this);
+		signal_handler_connect (handler, "source_destroy", onSourceRemoved, this);
+	}
+	connect (&events, &SourceEventQueue::ready, this, &SceneModel::dispatchEvents);
+	synchronize ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+SceneModel::~SceneModel ()
+{
+	if(signal_handler_t* handler = obs_get_signal_handler ())
+	{
+		signal_handler_disconnect (handler, "source_create", onSourceCreated, this);
+		signal_handler_disconnect (handler, "source_remove", onSourceRemoved, this);
+		signal_handler_disconnect (handler, "source_destroy", onSourceRemoved, this);
+	}
+	disconnect (&events, &SourceEventQueue::ready, this, &SceneModel::dispatchEvents);
+	clear ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::onSourceCreated (void* param, calldata_t* data)
+{
+	obs_source_t* obsSource = (obs_source_t*)calldata_ptr (data, "source");
+	if(!obsSource || obs_source_get_type (obsSource) != OBS_SOURCE_TYPE_SCENE)
+		return;
+	
+	reinterpret_cast<SceneModel*> (param)->scheduleSynchronize ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::onSourceRemoved (void* param, calldata_t* data)
+{
+	obs_source_t* obsSource = (obs_source_t*)calldata_ptr (data, "source");
+	if(!obsSource || obs_source_get_type (obsSource) != OBS_SOURCE_TYPE_SCENE)
+		return;
+	
+	reinterpret_cast<SceneModel*> (param)->scheduleSynchronize ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::scheduleSynchronize ()
+{
+	// OBS signals arrive on any thread, the model is only touched on ours.
+	// The frontend updates its list after the signal, so a queued synchronize sees the result.
+	if(synchronizePending.exchange (true))
+		return;
+	
+	QMetaObject::invokeMethod (this, [this] ()
+	{
+		if(!suspended && synchronize ()) // resume () synchronizes otherwise, until then we stay pending
+			emit sceneListChanged ();
+	}, Qt::QueuedConnection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::dispatchEvents ()
+{
+	// events of scenes we've dropped since they were posted are ignored, the lookup won't find them,
+	// or finds a newer wrapper of a source at the same address, with a different generation
+	events.drain (eventBatch, kMaxEventBatch);
+	if(suspended)
+		return; // resume () catches up instead
+	
+	for(const SourceEvent& event : eventBatch)
+	{
+		Scene* scene = findScene (event.source);
+		if(scene && event.isFor (scene->getInternal (), scene->getGeneration ()))
+			scene->handleEvent (event);
+		else if(Source* receiver = receivers.value (event.generation, nullptr))
+			receiver->handleEvent (event);
+	}
+	
+	if(events.takeOverflow ())
+	{
+		LOG ("SceneModel: event queue overflowed, resynchronizing")
+		for(auto scene : scenes)
+			scene->resynchronize ();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::suspend ()
+{
+	LOG ("SceneModel: suspended")
+	suspended = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::resume ()
+{
+	LOG ("SceneModel: resumed")
+	suspended = false;
+	
+	// what was posted in the meantime is stale, the scenes are matched to OBS as a whole instead
+	while(events.drain (eventBatch, kMaxEventBatch))
+		;
+	events.takeOverflow ();
+	
+	for(auto scene : scenes) // before synchronize (), the scenes it adds are new anyway
+		scene->resynchronize (false);
+	synchronize ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::addReceiver (Source& source)
+{
+	receivers.insert (source.getGeneration (), &source);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::removeReceiver (Source& source)
+{
+	receivers.remove (source.getGeneration ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+Scene* SceneModel::findScene (obs_source_t* source) const
+{
+	return sceneIndex.value (source, nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+Scene* SceneModel::findScene (const QString& name) const
+{
+	return nameIndex.value (name, nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::sceneRenamed (const Source& source)
+{
+	Scene* scene = findScene (source.getInternal ());
+	if(!scene)
+		return;
+	
+	for(auto i = nameIndex.begin (); i != nameIndex.end (); ++i)
+	{
+		if(i.value () == scene)
+		{
+			nameIndex.erase (i);
+			break;
+		}
+	}
+	nameIndex.insert (scene->getName (), scene);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SceneModel::synchronize ()
+{
+	synchronizePending = false;
+	
+	// keep the wrappers of scenes we already know, only new scenes get a new Scene
+	QHash<obs_source_t*, Scene*> remaining;
+	remaining.swap (sceneIndex);
+	QVector<Scene*> synchronized;
+	synchronized.reserve (scenes.count ());
+	QVector<Scene*> added;
+	
+	obs_frontend_source_list obsScenes = {};
+	obs_frontend_get_scenes (&obsScenes);
+	for(size_t i = 0; i < obsScenes.sources.num; i++)
+	{
+		obs_source_t* source = obsScenes.sources.array[i];
+		if(!source || sceneIndex.contains (source))
+			continue;
+		
+		Scene* scene = remaining.take (source);
+		if(!scene)
+		{
+			scene = new Scene (*source, &events);
+			connect (scene, &Source::renamed, this, &SceneModel::sceneRenamed);
+			added.append (scene);
+		}
+		synchronized.append (scene);
+		sceneIndex.insert (source, scene);
+	}
+	obs_frontend_source_list_free (&obsScenes);
+	
+	bool changed = !added.isEmpty () || !remaining.isEmpty () || synchronized != scenes;
+	scenes.swap (synchronized);
+	
+	nameIndex.clear ();
+	for(auto scene : scenes)
+		nameIndex.insert (scene->getName (), scene);
+	
+	for(auto scene : remaining)
+	{
+		LOG ("SceneModel: removed %s", STR (scene->getName ()))
+		emit sceneRemoved (*scene);
+		delete scene;
+	}
+	for(auto scene : added)
+	{
+		LOG ("SceneModel: added %s", STR (scene->getName ()))
+		emit sceneAdded (*scene);
+	}
+	return changed;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SceneModel::clear ()
+{
+	QVector<Scene*> removed;
+	removed.swap (scenes);
+	sceneIndex.clear ();
+	nameIndex.clear ();
+	
+	for(auto scene : removed)
+	{
+		emit sceneRemoved (*scene);
+		delete scene;
+	}
+}
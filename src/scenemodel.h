@@ -0,0 +1,90 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : scenemodel.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Long-lived model of the scene graph, kept current from OBS signals
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include "obsobjects.h"
+#include "sourceevents.h"
+
+#include <QtCore/QObject>
+#include <QVector>
+#include <QHash>
+
+#include <atomic>
+
+//************************************************************************************************
+// SceneModel
+//************************************************************************************************
+
+/** The frontend's scene list, built once and kept current from OBS signals instead of being
+	re-enumerated for every request. The Scene wrappers (and their SceneSources) live as long as
+	the scene does, so readers get names, order and item states without calling into OBS.
+	Their signals are posted to a SourceEventQueue by whichever thread OBS raises them on, and
+	handled here in batches, so the scenes are only ever changed on our thread. */
+class SceneModel : public QObject
+{
+	Q_OBJECT
+public:
+	SceneModel ();
+	~SceneModel ();
+	
+	const QVector<Scene*>& getScenes () const { return scenes; }
+	Scene* findScene (obs_source_t* source) const;
+	Scene* findScene (const QString& name) const; ///< O(1), kept current by the scenes' renamed ()
+	
+	bool synchronize (); ///< matches the model to the frontend's scene list, returns true if anything changed
+	void clear ();
+	void suspend (); ///< stops following OBS signals, e.g. while a scene collection loads
+	void resume (); ///< catches up with OBS once, without signaling the changes
+	bool isSuspended () const { return suspended; }
+	
+	SourceEventQueue& getEventQueue () { return events; } ///< for wrappers other than the scenes', see addReceiver ()
+	void addReceiver (Source& source); ///< the events it posts to our queue are handled here, until removeReceiver ()
+	void removeReceiver (Source& source);
+	
+	static void onSourceCreated (void* param, calldata_t* data);
+	static void onSourceRemoved (void* param, calldata_t* data);
+	
+signals:
+	void sceneAdded (Scene& scene);
+	void sceneRemoved (Scene& scene); ///< the scene is about to be deleted
+	void sceneListChanged (); ///< scenes were added, removed or reordered outside of synchronize ()
+	
+protected slots:
+	void dispatchEvents ();
+	void sceneRenamed (const Source& source);
+	
+protected:
+	static const int kMaxEventBatch = 256; ///< handled in one go before others get the thread
+	
+	void scheduleSynchronize ();
+	
+	SourceEventQueue events;
+	QVector<SourceEvent> eventBatch;
+	QVector<Scene*> scenes; ///< in frontend order
+	QHash<obs_source_t*, Scene*> sceneIndex;
+	QHash<QString, Scene*> nameIndex;
+	QHash<quint32, Source*> receivers; ///< by generation
+	std::atomic<bool> synchronizePending;
+	bool suspended;
+};
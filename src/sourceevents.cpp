@@ -0,0 +1,135 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : sourceevents.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Lock-free queue carrying OBS source signals to our thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "sourceevents.h"
+
+#include "moc_sourceevents.cpp"
+
+//************************************************************************************************
+// SourceEventQueue
+//************************************************************************************************
+
+SourceEventQueue::SourceEventQueue ()
+: writeIndex (0),
+  readIndex (0),
+  readyPending (false),
+  overflowed (false)
+{
+	static_assert ((kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of 2");
+	
+	// a cell is free for the producer whose index matches its sequence, and holds an event once it's index + 1
+	for(quint32 i = 0; i < kCapacity; i++)
+		cells[i].sequence.store (i, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SourceEventQueue::post (const SourceEvent& event)
+{
+	if(!push (event))
+	{
+		overflowed.store (true, std::memory_order_relaxed);
+		scheduleReady ();
+		return false;
+	}
+	scheduleReady ();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SourceEventQueue::scheduleReady ()
+{
+	if(readyPending.exchange (true))
+		return;
+	
+	QMetaObject::invokeMethod (this, [this] () { emit ready (); }, Qt::QueuedConnection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SourceEventQueue::push (const SourceEvent& event)
+{
+	quint32 write = writeIndex.load (std::memory_order_relaxed);
+	while(true)
+	{
+		Cell& cell = cells[write & (kCapacity - 1)];
+		qint32 distance = qint32 (cell.sequence.load (std::memory_order_acquire) - write);
+		if(distance == 0)
+		{
+			if(writeIndex.compare_exchange_weak (write, write + 1, std::memory_order_relaxed))
+			{
+				cell.event = event;
+				cell.sequence.store (write + 1, std::memory_order_release);
+				return true;
+			}
+			// another producer got it, write has been reloaded
+		}
+		else if(distance < 0)
+			return false; // full, the consumer hasn't freed this cell yet
+		else
+			write = writeIndex.load (std::memory_order_relaxed);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SourceEventQueue::pop (SourceEvent& event)
+{
+	Cell& cell = cells[readIndex & (kCapacity - 1)];
+	if(cell.sequence.load (std::memory_order_acquire) != readIndex + 1)
+		return false; // empty, or the producer hasn't finished writing it
+	
+	event = cell.event;
+	cell.sequence.store (readIndex + kCapacity, std::memory_order_release);
+	readIndex++;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SourceEventQueue::drain (QVector<SourceEvent>& batch, int maxCount)
+{
+	// reset before reading, whatever is posted from here on schedules another ready ()
+	readyPending.store (false);
+	
+	batch.resize (maxCount);
+	int count = 0;
+	while(count < maxCount && pop (batch[count]))
+		count++;
+	batch.resize (count);
+	
+	if(count == maxCount)
+		scheduleReady (); // there may be more, let others have the thread in between
+	return count > 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SourceEventQueue::takeOverflow ()
+{
+	return overflowed.exchange (false);
+}
@@ -0,0 +1,104 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : sourceevents.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Lock-free queue carrying OBS source signals to our thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <obs-module.h>
+#include <QtCore/QObject>
+#include <QVector>
+
+#include <atomic>
+
+//************************************************************************************************
+// SourceEvent
+//************************************************************************************************
+
+/** A source or scene signal as raised by OBS, small enough to be copied off the signaling thread. */
+struct SourceEvent
+{
+	enum Kind : quint8
+	{
+		kDestroyed,
+		kRemoved,
+		kActivated,		///< state: active
+		kShown,			///< state: visible
+		kEnabled,		///< state: enabled
+		kRenamed,
+		kItemAdded,		///< item
+		kItemRemoved,	///< item
+		kItemsReordered,
+		kItemsRefreshed,
+		kItemVisible,	///< item, state: visible
+		kItemLocked		///< item, state: locked
+	};
+	
+	Kind kind = kDestroyed;
+	obs_source_t* source = nullptr; ///< only to find the wrapper handling it again, not called before that
+	quint32 generation = 0; ///< of the wrapper handling it, as the address may be reused once the source is gone (see Source::getGeneration ())
+	obs_sceneitem_t* item = nullptr; ///< only compared, it may be gone by the time the event is handled
+	obs_sceneitem_t* sender = nullptr; ///< set if one of the scene's items posted it, the scene hands it on to the item's wrapper (also only compared)
+	bool state = false;
+	
+	bool isFor (const obs_source_t* wrapped, quint32 wrapperGeneration) const { return source == wrapped && generation == wrapperGeneration; } ///< false for those of an earlier wrapper
+};
+
+//************************************************************************************************
+// SourceEventQueue
+//************************************************************************************************
+
+/** Bounded multi-producer, single-consumer ring of source events. OBS threads post without
+	locking or allocating, the first event after a drain queues a single ready () to the thread
+	the queue lives on, where all of them are picked up in batches. When the ring is full, the
+	event is dropped and the consumer is told to resynchronize instead (see takeOverflow ()). */
+class SourceEventQueue : public QObject
+{
+	Q_OBJECT
+public:
+	SourceEventQueue ();
+	
+	static const quint32 kCapacity = 1024; ///< a power of 2
+	
+	bool post (const SourceEvent& event); ///< any thread, never blocks, false if the event was dropped
+	bool drain (QVector<SourceEvent>& batch, int maxCount); ///< consumer only, replaces batch with up to maxCount events, true if it got any
+	bool takeOverflow (); ///< consumer only, true once after events were dropped
+	
+signals:
+	void ready (); ///< events were posted since the last drain ()
+	
+protected:
+	struct Cell
+	{
+		std::atomic<quint32> sequence;
+		SourceEvent event;
+	};
+	
+	bool push (const SourceEvent& event);
+	bool pop (SourceEvent& event);
+	void scheduleReady ();
+	
+	Cell cells[kCapacity];
+	alignas (64) std::atomic<quint32> writeIndex; ///< claimed by the producers
+	alignas (64) quint32 readIndex; ///< consumer only
+	alignas (64) std::atomic<bool> readyPending;
+	std::atomic<bool> overflowed;
+};
@@ -27,29 +27,193 @@
 #include "common.h"
 
 #include <util/config-file.h>
+#include <string.h>
 
 //************************************************************************************************
 // Statistics
 //************************************************************************************************
 
 Statistics::Statistics ()
-: cpuUsageInfo (0)
+: cpuUsageInfo (0),
+  sequence (0),
+  cpuUsage (0),
+  residentBytes (0),
+  freeDiskBytes (-1),
+  streamingOutput (nullptr),
+  recordingPathChanged (false),
+  stopping (false)
 {
 	cpuUsageInfo = os_cpu_usage_info_start ();
+	
+	updateRecordingPath ();
+	updateStreamingOutput ();
+	QObject::connect (&pathTimer, &QTimer::timeout, [this] ()
+	{
+		updateRecordingPath ();
+		updateStreamingOutput ();
+	});
+	pathTimer.start (kDiskIntervalMs);
+	
+	sampler = std::thread ([this] () { run (); });
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 Statistics::~Statistics ()
 {
+	pathTimer.stop ();
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		stopping = true;
+	}
+	wakeUp.notify_one ();
+	if(sampler.joinable ())
+		sampler.join ();
+	
+	obs_weak_output_release (streamingOutput);
 	os_cpu_usage_info_destroy (cpuUsageInfo);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Statistics::run ()
+{
+	using namespace std::chrono;
+	
+	Sample sample;
+	steady_clock::time_point nextSample = steady_clock::now ();
+	steady_clock::time_point nextDisk = nextSample;
+	
+	std::unique_lock<std::mutex> guard (lock);
+	while(true)
+	{
+		wakeUp.wait_until (guard, qMin (nextSample, nextDisk), [this] () { return stopping || recordingPathChanged; });
+		if(stopping)
+			break;
+		
+		steady_clock::time_point now = steady_clock::now ();
+		bool sampleCpu = now >= nextSample;
+		bool sampleDisk = recordingPathChanged || now >= nextDisk;
+		recordingPathChanged = false;
+		QByteArray path = recordingPath;
+		AutoReleaseOutput output = sampleCpu ? obs_weak_output_get_output (streamingOutput) : nullptr;
+		guard.unlock ();
+		
+		if(sampleCpu)
+		{
+			sample.cpuUsage = os_cpu_usage_info_query (cpuUsageInfo);
+			sample.residentBytes = os_get_proc_resident_size ();
+			record (sample, output);
+			nextSample += milliseconds (kSampleIntervalMs);
+			if(nextSample < now) // we fell behind, don't try to catch up
+				nextSample = now + milliseconds (kSampleIntervalMs);
+		}
+		if(sampleDisk)
+		{
+			sample.freeDiskBytes = path.isEmpty () ? -1 : qint64 (os_get_free_disk_space (path.constData ()));
+			nextDisk = now + milliseconds (kDiskIntervalMs);
+		}
+		publish (sample);
+		
+		guard.lock ();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Statistics::publish (const Sample& sample)
+{
+	quint32 current = sequence.load (std::memory_order_relaxed);
+	sequence.store (current + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence (std::memory_order_release);
+	
+	cpuUsage.store (sample.cpuUsage, std::memory_order_relaxed);
+	residentBytes.store (sample.residentBytes, std::memory_order_relaxed);
+	freeDiskBytes.store (sample.freeDiskBytes, std::memory_order_relaxed);
+	
+	sequence.store (current + 2, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Statistics::record (const Sample& sample, obs_output_t* output)
+{
+	StatsHistory::Row row;
+	row.time = history.now ();
+	row.values[StatsHistory::kCpuUsage] = sample.cpuUsage;
+	row.values[StatsHistory::kMemoryUsage] = double (sample.residentBytes);
+	row.values[StatsHistory::kFps] = obs_get_active_fps ();
+	if(output)
+	{
+		row.values[StatsHistory::kTotalFrames] = obs_output_get_total_frames (output);
+		row.values[StatsHistory::kDroppedFrames] = obs_output_get_frames_dropped (output);
+		row.values[StatsHistory::kCongestion] = obs_output_get_congestion (output) * 100.;
+		row.values[StatsHistory::kOutputBytes] = double (obs_output_get_total_bytes (output));
+	}
+	history.append (row);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+Statistics::Sample Statistics::getSample () const
+{
+	Sample sample;
+	quint32 before = 0;
+	quint32 after = 0;
+	do
+	{
+		before = sequence.load (std::memory_order_acquire);
+		sample.cpuUsage = cpuUsage.load (std::memory_order_relaxed);
+		sample.residentBytes = residentBytes.load (std::memory_order_relaxed);
+		sample.freeDiskBytes = freeDiskBytes.load (std::memory_order_relaxed);
+		std::atomic_thread_fence (std::memory_order_acquire);
+		after = sequence.load (std::memory_order_relaxed);
+	} while((before & 1) || before != after);
+	return sample;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Statistics::updateRecordingPath ()
+{
+	// the same path the UI stats window uses...
+	QByteArray path;
+	if(config_t* currentProfile = obs_frontend_get_profile_config ())
+	{
+		const char* outputMode = config_get_string (currentProfile, "Output", "Mode");
+		bool isAdvanced = outputMode && strcmp (outputMode, "Advanced") == 0;
+		path = isAdvanced ? 
+					config_get_string (currentProfile, "AdvOut", "RecFilePath") :
+					config_get_string (currentProfile, "SimpleOutput", "FilePath");
+	}
+	
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		if(path == recordingPath)
+			return;
+		recordingPath = path;
+		recordingPathChanged = true;
+	}
+	wakeUp.notify_one ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Statistics::updateStreamingOutput ()
+{
+	AutoReleaseOutput output = obs_frontend_get_streaming_output ();
+	obs_weak_output_t* weakOutput = output ? obs_output_get_weak_output (output) : nullptr;
+	
+	std::lock_guard<std::mutex> guard (lock);
+	obs_weak_output_release (streamingOutput);
+	streamingOutput = weakOutput;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
 QString Statistics::getCpuUsage () const
 {
-	double cpu = os_cpu_usage_info_query (cpuUsageInfo);
+	double cpu = getSample ().cpuUsage;
 	QString string = QString::number (cpu, 'g', 2);
 	string.append ("%");
 	return string;
@@ -60,7 +224,7 @@ QString Statistics::getCpuUsage () const
 QString Statistics::getMemoryUsage () const
 {
 	// calculated the same way the UI stats window does...
-	long double num = static_cast<long double> (os_get_proc_resident_size ()) / (1024.0l * 1024.0l);
+	long double num = static_cast<long double> (getSample ().residentBytes) / (1024.0l * 1024.0l);
 	QString string = QString::number (num, 'f', 1) + QStringLiteral (" MB");
 	return string;
 }
@@ -70,22 +234,17 @@ QString Statistics::getMemoryUsage () const
 QString Statistics::getFreeDisk () const
 {
 	// calculated the same way the UI stats window does...
-	config_t* currentProfile = obs_frontend_get_profile_config ();
-	if(!currentProfile)
+	qint64 freeDiskBytes = getSample ().freeDiskBytes;
+	if(freeDiskBytes < 0)
 		return "Error";
 	
-	QString outputMode = config_get_string (currentProfile, "Output", "Mode");
-	QString path = (outputMode == "Advanced") ? 
-						config_get_string (currentProfile, "SimpleOutput", "FilePath") :
-						config_get_string (currentProfile, "AdvOut", "RecFilePath");
-	
 	static const long double kKilo = 1024ULL;
 	static const long double kMByte = (kKilo * kKilo);
 	static const long double kGByte = (kKilo * kKilo * kKilo);
 	static const long double kTByte = (kKilo * kKilo * kKilo * kKilo);
 
 	QString abbreviation = QStringLiteral (" MB");
-	long double numBytes = os_get_free_disk_space (path.toUtf8 ());
+	long double numBytes = freeDiskBytes;
 	long double num = numBytes / (1024.01 * 1024.01);
 	if(numBytes > kTByte)
 	{
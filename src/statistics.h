@@ -27,21 +27,70 @@
 #include <obs-frontend-api.h>
 #include <util/platform.h>
 #include <QString>
+#include <QByteArray>
+#include <QTimer>
+
+#include "statshistory.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 //************************************************************************************************
 // Statistics
 //************************************************************************************************
 
+/** CPU, memory and free disk space are sampled on a thread of their own at fixed intervals,
+	so the getters never block and the cpu usage is always measured over the same window.
+	Every cpu sample, along with the streaming output's statistics, also goes into the history. */
 class Statistics
 {
 public:
 	Statistics ();
 	~Statistics ();
 	
+	static const int kSampleIntervalMs = 1000; ///< cpu and memory (the cpu usage is the average over this window)
+	static const int kDiskIntervalMs = 5000; ///< free disk space, and how often the recording path and streaming output are looked up
+	
+	struct Sample
+	{
+		double cpuUsage = 0; ///< percent
+		quint64 residentBytes = 0;
+		qint64 freeDiskBytes = -1; ///< -1 while the recording path is unknown
+	};
+	Sample getSample () const; ///< the latest snapshot, lock-free
+	
 	QString getCpuUsage () const;
 	QString getMemoryUsage () const;
 	QString getFreeDisk () const;
 	
+	const StatsHistory& getHistory () const { return history; }
+	
 protected:
-	os_cpu_usage_info_t* cpuUsageInfo;
+	void run ();
+	void publish (const Sample& sample);
+	void record (const Sample& sample, obs_output_t* output);
+	void updateRecordingPath ();
+	void updateStreamingOutput ();
+	
+	os_cpu_usage_info_t* cpuUsageInfo; ///< only touched by the sampler thread once it runs
+	
+	// the snapshot, a seqlock: odd while the sampler thread is writing it
+	std::atomic<quint32> sequence;
+	std::atomic<double> cpuUsage;
+	std::atomic<quint64> residentBytes;
+	std::atomic<qint64> freeDiskBytes;
+	
+	StatsHistory history;
+	
+	std::thread sampler;
+	std::mutex lock; ///< guards everything below
+	std::condition_variable wakeUp;
+	QByteArray recordingPath; ///< looked up on the UI thread, the profile config isn't thread-safe
+	obs_weak_output_t* streamingOutput; ///< looked up on the UI thread as well, the frontend isn't thread-safe either
+	bool recordingPathChanged;
+	bool stopping;
+	
+	QTimer pathTimer;
 };
@@ -0,0 +1,156 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : statshistory.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Fixed-size history of the sampled statistics
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "statshistory.h"
+#include "obsremoteprotocol.h"
+
+#include <QDateTime>
+
+//************************************************************************************************
+// StatsHistory
+//************************************************************************************************
+
+StatsHistory::StatsHistory ()
+: rows (kCapacity),
+  head (0),
+  count (0)
+{
+	clock.start ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+qint64 StatsHistory::toWallTime (qint64 time) const
+{
+	return QDateTime::currentMSecsSinceEpoch () - (now () - time);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* StatsHistory::getSeriesName (int series)
+{
+	using namespace OBSRemoteProtocol;
+	static const char* kSeriesNames[kNumSeries] =
+	{
+		kItemCPU,
+		kItemMemory,
+		kItemFramesPerSecond,
+		kItemTotalFrames,
+		kItemDroppedFrames,
+		kItemCongestion,
+		kSeriesOutputBytes
+	};
+	if(series < 0 || series >= kNumSeries)
+		return nullptr;
+	return kSeriesNames[series];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int StatsHistory::findSeries (const QString& name)
+{
+	for(int series = 0; series < kNumSeries; series++)
+		if(name == QLatin1String (getSeriesName (series)))
+			return series;
+	return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StatsHistory::append (const Row& row)
+{
+	std::lock_guard<std::mutex> guard (lock);
+	rows[head] = row;
+	head = (head + 1) % kCapacity;
+	if(count < kCapacity)
+		count++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool StatsHistory::query (Range& range, qint64 from, qint64 to, int bucketCount, quint32 seriesMask) const
+{
+	if(to <= from || bucketCount <= 0)
+		return false;
+	
+	bucketCount = qMin (bucketCount, kMaxBuckets);
+	range.start = from;
+	range.step = qMax<qint64> (1, (to - from + bucketCount - 1) / bucketCount); // rounded up, so the last sample still has a bucket
+	range.counts.fill (0, bucketCount);
+	for(int series = 0; series < kNumSeries; series++)
+	{
+		bool wanted = (seriesMask & (1u << series)) != 0;
+		range.min[series].fill (0., wanted ? bucketCount : 0);
+		range.max[series].fill (0., wanted ? bucketCount : 0);
+		range.avg[series].fill (0., wanted ? bucketCount : 0);
+	}
+	
+	{
+		std::lock_guard<std::mutex> guard (lock);
+		
+		// newest to oldest, until the first sample before the range
+		for(int i = 0; i < count; i++)
+		{
+			const Row& row = rows[(head - 1 - i + kCapacity) % kCapacity];
+			if(row.time < from)
+				break;
+			if(row.time >= to)
+				continue;
+			
+			int bucket = int ((row.time - from) / range.step);
+			bool first = range.counts[bucket]++ == 0;
+			for(int series = 0; series < kNumSeries; series++)
+			{
+				if(!(seriesMask & (1u << series)))
+					continue;
+				
+				double value = row.values[series];
+				if(first)
+				{
+					range.min[series][bucket] = value;
+					range.max[series][bucket] = value;
+				}
+				else
+				{
+					range.min[series][bucket] = qMin (range.min[series][bucket], value);
+					range.max[series][bucket] = qMax (range.max[series][bucket], value);
+				}
+				range.avg[series][bucket] += value; // summed up here, divided below
+			}
+		}
+	}
+	
+	for(int series = 0; series < kNumSeries; series++)
+	{
+		if(!(seriesMask & (1u << series)))
+			continue;
+		for(int bucket = 0; bucket < bucketCount; bucket++)
+			if(range.counts[bucket] > 0)
+				range.avg[series][bucket] /= range.counts[bucket];
+	}
+	return true;
+}
@@ -0,0 +1,91 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : statshistory.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Fixed-size history of the sampled statistics
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+
+#include <mutex>
+
+//************************************************************************************************
+// StatsHistory
+//************************************************************************************************
+
+/** Ring buffer of time-stamped statistics samples, allocated once and overwritten oldest first.
+	The sampler thread appends, query () reduces a time range into evenly sized buckets with
+	min/max/avg per series. Counters (frames, bytes) are stored as they are, so the drops within
+	a bucket are its max minus its min. */
+class StatsHistory
+{
+public:
+	StatsHistory ();
+	
+	enum Series
+	{
+		kCpuUsage = 0, ///< percent
+		kMemoryUsage, ///< bytes
+		kFps, ///< frames per second actually rendered
+		kTotalFrames, ///< of the streaming output
+		kDroppedFrames, ///< of the streaming output
+		kCongestion, ///< percent, of the streaming output
+		kOutputBytes, ///< sent by the streaming output
+		
+		kNumSeries
+	};
+	static const char* getSeriesName (int series); ///< as named in the protocol
+	static int findSeries (const QString& name); ///< -1 if unknown
+	
+	static constexpr int kCapacity = 3600; ///< samples kept, an hour at Statistics::kSampleIntervalMs
+	static constexpr int kMaxBuckets = 1000;
+	
+	qint64 now () const { return clock.elapsed (); } ///< ms on the monotonic clock rows are stamped with
+	qint64 toWallTime (qint64 time) const; ///< ms since the epoch, for replies
+	
+	struct Row
+	{
+		qint64 time = 0; ///< see now (), wall-clock steps don't tear the history apart
+		double values[kNumSeries] = {};
+	};
+	void append (const Row& row);
+	
+	struct Range
+	{
+		qint64 start = 0; ///< see now (), the first bucket begins here
+		qint64 step = 0; ///< ms per bucket
+		QVector<int> counts; ///< samples in each bucket, 0 for gaps
+		QVector<double> min[kNumSeries]; ///< per series and bucket (only the series asked for are filled in)
+		QVector<double> max[kNumSeries];
+		QVector<double> avg[kNumSeries];
+	};
+	/** Buckets [from, to) into bucketCount buckets. seriesMask has bit (1 << Series) set for each series wanted. */
+	bool query (Range& range, qint64 from, qint64 to, int bucketCount, quint32 seriesMask) const;
+	
+protected:
+	QElapsedTimer clock;
+	mutable std::mutex lock; ///< guards everything below
+	QVector<Row> rows; ///< kCapacity rows, the oldest at head once full
+	int head; ///< where the next row goes
+	int count;
+};
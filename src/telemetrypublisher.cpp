@@ -0,0 +1,185 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : telemetrypublisher.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Pushes telemetry values to subscribed clients at their own rate
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#include "telemetrypublisher.h"
+#include "protocoladapter.h"
+#include "obsremoteprotocol.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "moc_telemetrypublisher.cpp"
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+using namespace OBSRemoteProtocol;
+
+//************************************************************************************************
+// TelemetryPublisher
+//************************************************************************************************
+
+TelemetryPublisher::TelemetryPublisher (ProtocolAdapter& adapter)
+: adapter (adapter)
+{
+	connect (&timer, &QTimer::timeout, this, &TelemetryPublisher::publish);
+	clock.start ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TelemetryPublisher::isTelemetryItem (const QString& name)
+{
+	static const char* kTelemetryItems[] =
+	{
+		kItemCPU,
+		kItemMemory,
+		kItemDisk,
+		kItemRecordingTime,
+		kItemStreamingTime,
+		kItemTotalFrames,
+		kItemDroppedFrames,
+		kItemCongestion,
+		kItemFramesPerSecond
+	};
+	
+	for(int i = 0; i < ARRAY_COUNT (kTelemetryItems); i++)
+		if(name == QLatin1String (kTelemetryItems[i]))
+			return true;
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TelemetryPublisher::subscribe (NetworkConnection& connection, const QString& name, int intervalMs, double deadband)
+{
+	int index = ProtocolAdapter::findItem (name);
+	if(index < 0 || !isTelemetryItem (name))
+		return;
+	
+	// the rate is per client, the latest subscription sets it. The deadband is per item.
+	Subscriber& subscriber = subscribers[&connection];
+	subscriber.items |= quint64 (1) << index;
+	subscriber.intervalMs = qMax (kMinIntervalMs, intervalMs);
+	subscriber.nextDueMs = clock.elapsed () + subscriber.intervalMs;
+	ItemState& itemState = subscriber.itemStates[index];
+	itemState.deadband = deadband;
+	itemState.sent = false;
+	
+	LOG ("TelemetryPublisher: %s every %d ms, deadband %.2f", STR (name), subscriber.intervalMs, deadband)
+	updateTimer ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TelemetryPublisher::unsubscribe (NetworkConnection& connection, const QString& name)
+{
+	auto subscriber = subscribers.find (&connection);
+	if(subscriber == subscribers.end ())
+		return;
+	
+	int index = ProtocolAdapter::findItem (name);
+	if(index < 0)
+		return;
+	
+	subscriber->items &= ~(quint64 (1) << index);
+	subscriber->itemStates.remove (index);
+	if(subscriber->items == 0)
+		subscribers.erase (subscriber);
+	updateTimer ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TelemetryPublisher::removeClient (NetworkConnection& connection)
+{
+	if(subscribers.remove (&connection))
+		updateTimer ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TelemetryPublisher::updateTimer ()
+{
+	// tick at the fastest rate anyone asked for, clients with slower rates are served every few ticks
+	int intervalMs = 0;
+	for(const Subscriber& subscriber : subscribers)
+		if(intervalMs == 0 || subscriber.intervalMs < intervalMs)
+			intervalMs = subscriber.intervalMs;
+	
+	if(intervalMs == 0)
+		timer.stop ();
+	else if(!timer.isActive () || timer.interval () != intervalMs)
+		timer.start (intervalMs);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TelemetryPublisher::publish ()
+{
+	qint64 now = clock.elapsed ();
+	qint64 slack = timer.interval () / 2; // don't miss a period because the timer fired a little early
+	
+	QHash<int, QJsonObject> samples; // each item is sampled once per tick and value mode, shared by all clients
+	QHash<int, QByteArray> serialized;
+	auto sample = [&] (int index, bool raw) -> const QJsonObject&
+	{
+		int key = index * 2 + (raw ? 1 : 0);
+		auto i = samples.find (key);
+		if(i == samples.end ())
+			i = samples.insert (key, adapter.get (ProtocolAdapter::getItemName (index), raw).toObject ());
+		return *i;
+	};
+	
+	for(auto i = subscribers.begin (); i != subscribers.end (); ++i)
+	{
+		Subscriber& subscriber = i.value ();
+		if(subscriber.nextDueMs > now + slack)
+			continue;
+		subscriber.nextDueMs = qMax (subscriber.nextDueMs + subscriber.intervalMs, now + slack);
+		bool raw = adapter.wantsRawValues (i.key ());
+		
+		for(int index = 0; index < ProtocolAdapter::countItems (); index++)
+		{
+			if((subscriber.items & (quint64 (1) << index)) == 0)
+				continue;
+			
+			// the deadband applies to the numeric raw value, only what's sent is formatted
+			ItemState& itemState = subscriber.itemStates[index];
+			if(itemState.deadband >= 0)
+			{
+				double value = sample (index, true).value (kValueItemValue).toDouble ();
+				if(itemState.sent && qAbs (value - itemState.lastSent) <= itemState.deadband)
+					continue;
+				itemState.lastSent = value;
+				itemState.sent = true;
+			}
+			
+			int key = index * 2 + (raw ? 1 : 0);
+			auto item = serialized.find (key);
+			if(item == serialized.end ())
+				item = serialized.insert (key, QJsonDocument (sample (index, raw)).toJson (QJsonDocument::Compact));
+			adapter.queue (ProtocolAdapter::getItemName (index), *item, i.key ());
+		}
+	}
+}
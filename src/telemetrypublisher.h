@@ -0,0 +1,81 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : telemetrypublisher.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Pushes telemetry values to subscribed clients at their own rate
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <QtCore/QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+
+class ProtocolAdapter;
+class NetworkConnection;
+
+//************************************************************************************************
+// TelemetryPublisher
+//************************************************************************************************
+
+/** Samples the telemetry items (cpu, memory, disk, output statistics, times) on the server and
+	pushes them to the clients that subscribed to them, each at the interval it asked for.
+	An item is sampled once per period, no matter how many clients want it. With a deadband,
+	a value that hasn't moved by more than that since it was last sent to the client is skipped. */
+class TelemetryPublisher : public QObject
+{
+	Q_OBJECT
+public:
+	TelemetryPublisher (ProtocolAdapter& adapter);
+	
+	static const int kDefaultIntervalMs = 1000;
+	static const int kMinIntervalMs = 100;
+	static bool isTelemetryItem (const QString& name);
+	
+	void subscribe (NetworkConnection& connection, const QString& name, int intervalMs, double deadband = -1); ///< deadband < 0: send every period
+	void unsubscribe (NetworkConnection& connection, const QString& name);
+	void removeClient (NetworkConnection& connection);
+	
+protected slots:
+	void publish ();
+	
+protected:
+	struct ItemState
+	{
+		double deadband = -1; ///< in the item's raw unit, items differ (percent, bytes, nanoseconds)
+		double lastSent = 0; ///< raw value, whatever the client's value mode
+		bool sent = false;
+	};
+	
+	struct Subscriber
+	{
+		quint64 items = 0; ///< ProtocolAdapter item bits
+		int intervalMs = kDefaultIntervalMs;
+		qint64 nextDueMs = 0;
+		QHash<int, ItemState> itemStates; ///< by item index
+	};
+	
+	void updateTimer ();
+	
+	ProtocolAdapter& adapter;
+	QHash<NetworkConnection*, Subscriber> subscribers;
+	QTimer timer;
+	QElapsedTimer clock;
+};
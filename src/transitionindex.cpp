@@ -0,0 +1,121 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : transitionindex.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Frontend transitions by name
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#define ENABLE_LOGGING 0
+#include "common.h"
+
+#include "transitionindex.h"
+
+#include <obs-frontend-api.h>
+
+//************************************************************************************************
+// TransitionIndex
+//************************************************************************************************
+
+TransitionIndex::TransitionIndex ()
+: dirty (true)
+{}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+TransitionIndex::~TransitionIndex ()
+{
+	release ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TransitionIndex::onRenamed (void* param, calldata_t* data)
+{
+	reinterpret_cast<TransitionIndex*> (param)->invalidate ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TransitionIndex::invalidate ()
+{
+	dirty = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+obs_source_t* TransitionIndex::find (const QString& name)
+{
+	if(dirty.exchange (false))
+		rebuild ();
+	
+	obs_weak_source_t* weakSource = transitions.value (name, nullptr);
+	return weakSource ? obs_weak_source_get_source (weakSource) : nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TransitionIndex::rebuild ()
+{
+	release ();
+	
+	obs_frontend_source_list obsTransitions = {};
+	obs_frontend_get_transitions (&obsTransitions);
+	for(size_t i = 0; i < obsTransitions.sources.num; i++)
+	{
+		obs_source_t* source = obsTransitions.sources.array[i];
+		const char* name = source ? obs_source_get_name (source) : nullptr;
+		if(!name)
+			continue;
+		
+		// names aren't unique among private sources, the first one wins like it did when enumerating
+		QString key (name);
+		if(transitions.contains (key))
+			continue;
+		
+		// transitions are private sources, their renames don't show up in the global signals
+		if(signal_handler_t* handler = obs_source_get_signal_handler (source))
+			signal_handler_connect (handler, "rename", onRenamed, this);
+		transitions.insert (key, obs_source_get_weak_source (source));
+	}
+	obs_frontend_source_list_free (&obsTransitions);
+	LOG ("TransitionIndex: %d transitions", transitions.count ())
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TransitionIndex::clear ()
+{
+	release ();
+	dirty = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TransitionIndex::release ()
+{
+	for(obs_weak_source_t* weakSource : transitions)
+	{
+		// the ones that are gone took their signal handler with them
+		AutoReleaseSource source = obs_weak_source_get_source (weakSource);
+		if(signal_handler_t* handler = source ? obs_source_get_signal_handler (source) : nullptr)
+			signal_handler_disconnect (handler, "rename", onRenamed, this);
+		obs_weak_source_release (weakSource);
+	}
+	transitions.clear ();
+}
@@ -0,0 +1,57 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : transitionindex.h
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Frontend transitions by name
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+#pragma once
+
+#include <obs-module.h>
+#include <QString>
+#include <QHash>
+
+#include <atomic>
+
+//************************************************************************************************
+// TransitionIndex
+//************************************************************************************************
+
+/** The frontend's transitions by name, as weak references, so one is found without enumerating
+	them or wrapping each one. Rebuilt on the first lookup after the list changed (invalidate ())
+	or one of them was renamed, a transition that's gone is told by its weak reference. */
+class TransitionIndex
+{
+public:
+	TransitionIndex ();
+	~TransitionIndex ();
+	
+	obs_source_t* find (const QString& name); ///< adds a reference (see AutoReleaseSource), nullptr if there's no such transition
+	void invalidate (); ///< any thread
+	void clear (); ///< releases the references, the next find () rebuilds
+	
+	static void onRenamed (void* param, calldata_t* data);
+	
+protected:
+	void rebuild ();
+	void release ();
+	
+	QHash<QString, obs_weak_source_t*> transitions;
+	std::atomic<bool> dirty;
+};
@@ -91,6 +91,26 @@ UCOBSControlPlugin::UCOBSControlPlugin ()
 		qint64 bytesWritten = configFile.write (jsonDoc.toJson ());
 		configFile.close ();
 	}
+	
+	QString ioMode = values.value (OBSRemoteProtocol::kIOModeId).toString ();
+	if(ioMode.compare (OBSRemoteProtocol::kIOModePolling, Qt::CaseInsensitive) == 0)
+		server.setIOMode (NetworkServer::kPolling);
+	
+	QString engine = values.value (OBSRemoteProtocol::kEngineId).toString ();
+	if(engine.compare (OBSRemoteProtocol::kEngineAsio, Qt::CaseInsensitive) == 0)
+		server.setEngine (NetworkServer::kAsioEngine);
+	
+	qint64 maxFrameSize = values.value (OBSRemoteProtocol::kMaxFrameSizeId).toVariant ().toLongLong ();
+	if(maxFrameSize > 0)
+		server.setMaxFrameSize (maxFrameSize);
+	
+	if(values.value (OBSRemoteProtocol::kTcpNoDelayId).toBool ())
+		server.setLowDelay (true);
+	
+	adapter.setFlushWindow (values.value (OBSRemoteProtocol::kFlushWindowId).toInt ());
+	adapter.setSceneDebounce (values.value (OBSRemoteProtocol::kSceneDebounceId).toInt (Debouncer::kDefaultQuietMs),
+							  values.value (OBSRemoteProtocol::kSceneMaxLatencyId).toInt (Debouncer::kDefaultMaxLatencyMs));
+	
 	server.start (port);
 }
 
@@ -0,0 +1,158 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : debouncertest.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Unit tests of the Debouncer
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#include "debouncer.h"
+
+#include <QtTest>
+
+//************************************************************************************************
+// ManualDebouncer
+//************************************************************************************************
+
+/** Runs the bursts on a clock set by the test, so deadlines don't depend on how the test is scheduled. */
+class ManualDebouncer : public Debouncer
+{
+public:
+	qint64 now = 0;
+	
+	int getDelay () const { return timer.interval (); } ///< of the last trigger ()
+	
+protected:
+	qint64 burstStart = 0;
+	
+	void startBurst () override { burstStart = now; }
+	qint64 getBurstElapsed () const override { return now - burstStart; }
+};
+
+//************************************************************************************************
+// DebouncerTest
+//************************************************************************************************
+
+class DebouncerTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void firesOnceAfterQuietPeriod ();
+	void firesWithinMaxLatency ();
+	void flushFiresNow ();
+	void cancelDropsBurst ();
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DebouncerTest::firesOnceAfterQuietPeriod ()
+{
+	Debouncer debouncer;
+	debouncer.setQuietPeriod (50);
+	debouncer.setMaxLatency (1000);
+	QSignalSpy spy (&debouncer, &Debouncer::fired);
+	
+	QElapsedTimer clock;
+	for(int i = 0; i < 3; i++)
+		debouncer.trigger ();
+	clock.start ();
+	QVERIFY (debouncer.isPending ());
+	
+	QTest::qWait (20);
+	QCOMPARE (spy.count (), 0);
+	
+	QTRY_COMPARE_WITH_TIMEOUT (spy.count (), 1, 1000);
+	QVERIFY (clock.elapsed () >= 45); // timers may be a little early
+	QVERIFY (!debouncer.isPending ());
+	
+	QTest::qWait (100);
+	QCOMPARE (spy.count (), 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DebouncerTest::firesWithinMaxLatency ()
+{
+	ManualDebouncer debouncer;
+	debouncer.setQuietPeriod (50);
+	debouncer.setMaxLatency (150);
+	QSignalSpy spy (&debouncer, &Debouncer::fired);
+	
+	// triggers keep coming faster than the quiet period, the deadline still closes in on the max latency
+	for(qint64 now = 0; now < 150; now += 10)
+	{
+		debouncer.now = now;
+		debouncer.trigger ();
+		QCOMPARE (debouncer.getDelay (), int (qMin<qint64> (50, 150 - now)));
+	}
+	QCOMPARE (spy.count (), 0);
+	
+	debouncer.now = 150;
+	debouncer.trigger ();
+	QCOMPARE (debouncer.getDelay (), 0);
+	QTRY_COMPARE_WITH_TIMEOUT (spy.count (), 1, 1000);
+	QVERIFY (!debouncer.isPending ());
+	
+	// the next trigger starts a new burst
+	debouncer.now = 160;
+	debouncer.trigger ();
+	QCOMPARE (debouncer.getDelay (), 50);
+	debouncer.flush ();
+	QCOMPARE (spy.count (), 2);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DebouncerTest::flushFiresNow ()
+{
+	Debouncer debouncer;
+	debouncer.setQuietPeriod (1000);
+	QSignalSpy spy (&debouncer, &Debouncer::fired);
+	
+	debouncer.flush (); // nothing pending
+	QCOMPARE (spy.count (), 0);
+	
+	debouncer.trigger ();
+	debouncer.flush ();
+	QCOMPARE (spy.count (), 1);
+	QVERIFY (!debouncer.isPending ());
+	
+	debouncer.flush ();
+	QCOMPARE (spy.count (), 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DebouncerTest::cancelDropsBurst ()
+{
+	Debouncer debouncer;
+	debouncer.setQuietPeriod (20);
+	QSignalSpy spy (&debouncer, &Debouncer::fired);
+	
+	debouncer.trigger ();
+	debouncer.cancel ();
+	QVERIFY (!debouncer.isPending ());
+	QTest::qWait (60);
+	QCOMPARE (spy.count (), 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QTEST_GUILESS_MAIN (DebouncerTest)
+#include "debouncertest.moc"
@@ -0,0 +1,153 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : itembitstest.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Unit tests of the ItemBits
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#include "itembits.h"
+
+#include <QtTest>
+
+//************************************************************************************************
+// ItemBitsTest
+//************************************************************************************************
+
+class ItemBitsTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void setsBits ();
+	void encodesBytes ();
+	void roundTrips ();
+	void masksTail ();
+	void rejectsShortData ();
+	void findsDifferences ();
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBitsTest::setsBits ()
+{
+	ItemBits bits (70);
+	QCOMPARE (bits.getCount (), 70);
+	for(int i = 0; i < 70; i++)
+		QVERIFY (!bits.isSet (i));
+	
+	bits.set (0, true);
+	bits.set (64, true);
+	bits.set (69, true);
+	bits.set (70, true); // out of range, ignored
+	bits.set (-1, true);
+	QVERIFY (bits.isSet (0) && bits.isSet (64) && bits.isSet (69));
+	QVERIFY (!bits.isSet (70) && !bits.isSet (-1));
+	
+	bits.set (64, false);
+	QVERIFY (!bits.isSet (64));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBitsTest::encodesBytes ()
+{
+	// item i is bit (i % 8) of byte (i / 8)
+	ItemBits bits (10);
+	bits.set (1, true);
+	bits.set (9, true);
+	QCOMPARE (bits.toBase64 (), QByteArray ("AgI="));
+	QCOMPARE (ItemBits ().toBase64 (), QByteArray ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBitsTest::roundTrips ()
+{
+	for(int count : {1, 7, 8, 9, 63, 64, 65, 130})
+	{
+		ItemBits bits (count);
+		for(int i = 0; i < count; i++)
+			bits.set (i, (i * 7) % 3 == 0);
+		
+		ItemBits decoded;
+		QVERIFY (ItemBits::fromBase64 (decoded, bits.toBase64 (), count));
+		QCOMPARE (decoded.getCount (), count);
+		for(int i = 0; i < count; i++)
+			QCOMPARE (decoded.isSet (i), bits.isSet (i));
+		
+		int differences = 0;
+		decoded.forEachDifference (bits, [&] (int, bool) { differences++; });
+		QCOMPARE (differences, 0);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBitsTest::masksTail ()
+{
+	// a client may send set bits past the count, they must not show up as differences
+	QByteArray allSet = QByteArray (16, char (0xff)).toBase64 ();
+	ItemBits decoded;
+	QVERIFY (ItemBits::fromBase64 (decoded, allSet, 70));
+	QCOMPARE (decoded.getCount (), 70);
+	QVERIFY (decoded.isSet (69));
+	QVERIFY (!decoded.isSet (70));
+	
+	ItemBits expected (70);
+	for(int i = 0; i < 70; i++)
+		expected.set (i, true);
+	int differences = 0;
+	decoded.forEachDifference (expected, [&] (int, bool) { differences++; });
+	QCOMPARE (differences, 0);
+	
+	// without a count, as many as the bytes hold
+	QVERIFY (ItemBits::fromBase64 (decoded, allSet));
+	QCOMPARE (decoded.getCount (), 128);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBitsTest::rejectsShortData ()
+{
+	ItemBits decoded;
+	QVERIFY (!ItemBits::fromBase64 (decoded, QByteArray (1, char (0xff)).toBase64 (), 9));
+	QVERIFY (ItemBits::fromBase64 (decoded, QByteArray (2, char (0xff)).toBase64 (), 9));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ItemBitsTest::findsDifferences ()
+{
+	ItemBits current (100);
+	ItemBits requested (100);
+	current.set (3, true);
+	requested.set (3, true);
+	requested.set (5, true);
+	requested.set (99, true);
+	current.set (64, true);
+	
+	QVector<QPair<int, bool>> differences;
+	requested.forEachDifference (current, [&] (int index, bool state) { differences.append (qMakePair (index, state)); });
+	QCOMPARE (differences, (QVector<QPair<int, bool>> {{5, true}, {64, false}, {99, true}}));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QTEST_GUILESS_MAIN (ItemBitsTest)
+#include "itembitstest.moc"
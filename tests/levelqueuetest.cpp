@@ -0,0 +1,149 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : levelqueuetest.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Unit tests of the LevelQueue
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#include "levelqueue.h"
+
+#include <QtTest>
+
+//************************************************************************************************
+// LevelQueueTest
+//************************************************************************************************
+
+class LevelQueueTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void startsSilent ();
+	void holdsPeaks ();
+	void popsInOrder ();
+	void carriesWhenFull ();
+	
+protected:
+	static MeterLevels makeLevels (float magnitude, float peak);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+MeterLevels LevelQueueTest::makeLevels (float magnitude, float peak)
+{
+	MeterLevels levels;
+	for(int i = 0; i < MAX_AUDIO_CHANNELS; i++)
+	{
+		levels.magnitude[i] = magnitude;
+		levels.peak[i] = peak;
+		levels.inputPeak[i] = peak;
+	}
+	return levels;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LevelQueueTest::startsSilent ()
+{
+	MeterLevels levels;
+	for(int i = 0; i < MAX_AUDIO_CHANNELS; i++)
+	{
+		QVERIFY (qIsInf (levels.magnitude[i]) && levels.magnitude[i] < 0);
+		QVERIFY (qIsInf (levels.peak[i]) && levels.peak[i] < 0);
+		QVERIFY (qIsInf (levels.inputPeak[i]) && levels.inputPeak[i] < 0);
+	}
+	
+	LevelQueue queue;
+	QVERIFY (!queue.pop (levels));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LevelQueueTest::holdsPeaks ()
+{
+	MeterLevels held = makeLevels (-10.f, -3.f);
+	held.hold (makeLevels (-20.f, -12.f));
+	QCOMPARE (held.magnitude[0], -20.f); // the newer one
+	QCOMPARE (held.peak[0], -3.f); // the higher one
+	QCOMPARE (held.inputPeak[MAX_AUDIO_CHANNELS - 1], -3.f);
+	
+	held.hold (makeLevels (-30.f, 0.f));
+	QCOMPARE (held.magnitude[0], -30.f);
+	QCOMPARE (held.peak[0], 0.f);
+	
+	MeterLevels silence;
+	silence.hold (makeLevels (-40.f, -40.f));
+	QCOMPARE (silence.peak[0], -40.f);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LevelQueueTest::popsInOrder ()
+{
+	LevelQueue queue;
+	for(int i = 0; i < 3; i++)
+		queue.push (makeLevels (-float (i), -float (i)));
+	
+	MeterLevels levels;
+	for(int i = 0; i < 3; i++)
+	{
+		QVERIFY (queue.pop (levels));
+		QCOMPARE (levels.magnitude[0], -float (i));
+	}
+	QVERIFY (!queue.pop (levels));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LevelQueueTest::carriesWhenFull ()
+{
+	LevelQueue queue;
+	for(quint32 i = 0; i < LevelQueue::kCapacity; i++)
+		queue.push (makeLevels (-60.f, -60.f));
+	
+	// the ring is full, these are folded into the carried reading instead of being dropped
+	queue.push (makeLevels (-50.f, 0.f)); // a transient
+	queue.push (makeLevels (-40.f, -20.f));
+	
+	MeterLevels levels;
+	QVERIFY (queue.pop (levels));
+	QCOMPARE (levels.peak[0], -60.f);
+	
+	// the next reading pushes the carry, with the transient's peak and the newest magnitude
+	queue.push (makeLevels (-30.f, -45.f));
+	
+	quint32 count = 0;
+	while(queue.pop (levels))
+		count++;
+	QCOMPARE (count, LevelQueue::kCapacity);
+	QCOMPARE (levels.magnitude[0], -30.f);
+	QCOMPARE (levels.peak[0], 0.f);
+	QCOMPARE (levels.inputPeak[0], 0.f);
+	
+	// once it's pushed, the carry starts over
+	queue.push (makeLevels (-70.f, -70.f));
+	QVERIFY (queue.pop (levels));
+	QCOMPARE (levels.peak[0], -70.f);
+	QVERIFY (!queue.pop (levels));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QTEST_GUILESS_MAIN (LevelQueueTest)
+#include "levelqueuetest.moc"
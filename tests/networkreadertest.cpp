@@ -0,0 +1,231 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : networkreadertest.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Unit tests of the NetworkReader framing
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#include "networkconnection.h"
+#include "obsremoteprotocol.h"
+
+#include <QtTest>
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+//************************************************************************************************
+// NetworkReaderTest
+//************************************************************************************************
+
+class NetworkReaderTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void init ();
+	void cleanup ();
+	
+	void readsLegacyFrames ();
+	void readsV2Frames ();
+	void rejectsBadMagic ();
+	void rejectsOversizeFrames ();
+	void joinsSplitReads ();
+	void readsBackToBackFrames ();
+	
+protected:
+	QBuffer* device = nullptr; ///< what the "client" sent, appended to by feed ()
+	
+	void feed (const QByteArray& bytes) { device->buffer ().append (bytes); }
+	static QByteArray makePayload (int value);
+	static QByteArray makeV2Header (quint32 size);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::init ()
+{
+	device = new QBuffer;
+	device->open (QIODevice::ReadOnly);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::cleanup ()
+{
+	delete device;
+	device = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray NetworkReaderTest::makePayload (int value)
+{
+	QJsonObject json;
+	json["value"] = value;
+	return QJsonDocument (json).toJson (QJsonDocument::Compact);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QByteArray NetworkReaderTest::makeV2Header (quint32 size)
+{
+	QByteArray header (OBSRemoteProtocol::kNumHeaderBytesV2, 0);
+	header[0] = char (OBSRemoteProtocol::kFrameMagicV2);
+	qToBigEndian<quint32> (size, header.data () + 1);
+	return header;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::readsLegacyFrames ()
+{
+	NetworkReader reader (*device);
+	QSignalSpy spy (&reader, &NetworkReader::receivedJson);
+	
+	feed (NetworkWriter::encodeFrame (makePayload (1), kLegacyFraming));
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 1);
+	QCOMPARE (spy[0][0].toJsonObject ()["value"].toInt (), 1);
+	QCOMPARE (reader.getFraming (), kLegacyFraming);
+	
+	feed ("12ab");
+	QVERIFY (!reader.read ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::readsV2Frames ()
+{
+	NetworkReader reader (*device);
+	QSignalSpy spy (&reader, &NetworkReader::receivedJson);
+	
+	QByteArray payload = makePayload (2);
+	QByteArray frame = NetworkWriter::encodeFrame (payload, kFramingV2);
+	QCOMPARE (frame.left (OBSRemoteProtocol::kNumHeaderBytesV2), makeV2Header (quint32 (payload.size ())));
+	
+	feed (frame);
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 1);
+	QCOMPARE (spy[0][0].toJsonObject ()["value"].toInt (), 2);
+	QCOMPARE (reader.getFraming (), kFramingV2);
+	
+	// over what 4 digits can describe
+	QJsonObject large;
+	large["text"] = QString (OBSRemoteProtocol::kMaxPayloadBytesLegacy + 1, 'x');
+	QByteArray largePayload = QJsonDocument (large).toJson (QJsonDocument::Compact);
+	QVERIFY (NetworkWriter::encodeFrame (largePayload, kLegacyFraming).isEmpty ());
+	feed (NetworkWriter::encodeFrame (largePayload, kFramingV2));
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 2);
+	QCOMPARE (spy[1][0].toJsonObject ()["text"].toString ().size (), OBSRemoteProtocol::kMaxPayloadBytesLegacy + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::rejectsBadMagic ()
+{
+	NetworkReader reader (*device);
+	QSignalSpy spy (&reader, &NetworkReader::receivedJson);
+	
+	// the meter magic is only ever sent by the server
+	QByteArray payload = makePayload (3);
+	QByteArray frame = makeV2Header (quint32 (payload.size ())) + payload;
+	frame[0] = char (OBSRemoteProtocol::kFrameMagicMeters);
+	feed (frame);
+	QVERIFY (!reader.read ());
+	QCOMPARE (spy.count (), 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::rejectsOversizeFrames ()
+{
+	NetworkReader reader (*device);
+	reader.setMaxFrameSize (64);
+	QSignalSpy spy (&reader, &NetworkReader::receivedJson);
+	
+	QByteArray payload = "{\"t\":\"" + QByteArray (56, 'x') + "\"}"; // right at the limit
+	QCOMPARE (payload.size (), 64);
+	feed (makeV2Header (64) + payload);
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 1);
+	
+	// rejected by its header alone, before the payload is there
+	feed (makeV2Header (65));
+	QVERIFY (!reader.read ());
+	
+	NetworkReader other (*device); // the default limit
+	feed (makeV2Header (0xffffffff));
+	QVERIFY (!other.read ());
+	QCOMPARE (spy.count (), 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::joinsSplitReads ()
+{
+	NetworkReader reader (*device);
+	QSignalSpy spy (&reader, &NetworkReader::receivedJson);
+	
+	// one byte at a time, the header split too
+	QByteArray frame = NetworkWriter::encodeFrame (makePayload (4), kFramingV2);
+	for(int i = 0; i < frame.size (); i++)
+	{
+		QCOMPARE (spy.count (), 0);
+		feed (frame.mid (i, 1));
+		QVERIFY (reader.read ());
+	}
+	QCOMPARE (spy.count (), 1);
+	QCOMPARE (spy[0][0].toJsonObject ()["value"].toInt (), 4);
+	
+	// a frame that ends in the middle of the next one's header
+	QByteArray frames = NetworkWriter::encodeFrame (makePayload (5), kFramingV2) + NetworkWriter::encodeFrame (makePayload (6), kFramingV2);
+	int split = frames.size () / 2 + 3;
+	feed (frames.left (split));
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 2);
+	feed (frames.mid (split));
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 3);
+	QCOMPARE (spy[2][0].toJsonObject ()["value"].toInt (), 6);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NetworkReaderTest::readsBackToBackFrames ()
+{
+	NetworkReader reader (*device);
+	QSignalSpy spy (&reader, &NetworkReader::receivedJson);
+	
+	// both framings may be mixed, per message
+	QByteArray frames;
+	for(int i = 0; i < 10; i++)
+		frames += NetworkWriter::encodeFrame (makePayload (i), i % 2 ? kFramingV2 : kLegacyFraming);
+	feed (frames);
+	QVERIFY (reader.read ());
+	QCOMPARE (spy.count (), 10);
+	for(int i = 0; i < 10; i++)
+		QCOMPARE (spy[i][0].toJsonObject ()["value"].toInt (), i);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QTEST_GUILESS_MAIN (NetworkReaderTest)
+#include "networkreadertest.moc"
@@ -0,0 +1,170 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : sourceeventstest.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Unit tests of the SourceEventQueue
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#include "sourceevents.h"
+
+#include <QtTest>
+
+//************************************************************************************************
+// SourceEventsTest
+//************************************************************************************************
+
+class SourceEventsTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void drainsInOrder ();
+	void drainsInBatches ();
+	void signalsReadyOnce ();
+	void overflows ();
+	void filtersGenerations ();
+	
+protected:
+	static obs_source_t* fakeSource (quintptr address) { return reinterpret_cast<obs_source_t*> (address); } ///< only compared, never called
+	static SourceEvent makeEvent (quint32 generation, SourceEvent::Kind kind = SourceEvent::kRenamed);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+SourceEvent SourceEventsTest::makeEvent (quint32 generation, SourceEvent::Kind kind)
+{
+	SourceEvent event;
+	event.kind = kind;
+	event.source = fakeSource (0x1000);
+	event.generation = generation;
+	return event;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SourceEventsTest::drainsInOrder ()
+{
+	SourceEventQueue queue;
+	QVector<SourceEvent> batch;
+	QVERIFY (!queue.drain (batch, 16));
+	QVERIFY (batch.isEmpty ());
+	
+	for(quint32 i = 0; i < 5; i++)
+		QVERIFY (queue.post (makeEvent (i)));
+	QVERIFY (queue.drain (batch, 16));
+	QCOMPARE (batch.count (), 5);
+	for(int i = 0; i < batch.count (); i++)
+		QCOMPARE (batch[i].generation, quint32 (i));
+	
+	QVERIFY (!queue.drain (batch, 16));
+	QVERIFY (!queue.takeOverflow ());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SourceEventsTest::drainsInBatches ()
+{
+	SourceEventQueue queue;
+	for(quint32 i = 0; i < 10; i++)
+		queue.post (makeEvent (i));
+	
+	QVector<SourceEvent> batch;
+	QVERIFY (queue.drain (batch, 4));
+	QCOMPARE (batch.count (), 4);
+	QVERIFY (queue.drain (batch, 4));
+	QCOMPARE (batch.first ().generation, quint32 (4));
+	QVERIFY (queue.drain (batch, 4));
+	QCOMPARE (batch.count (), 2);
+	QCOMPARE (batch.last ().generation, quint32 (9));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SourceEventsTest::signalsReadyOnce ()
+{
+	SourceEventQueue queue;
+	QSignalSpy spy (&queue, &SourceEventQueue::ready);
+	
+	// ready () is queued, however many events are posted before the consumer gets to them
+	for(quint32 i = 0; i < 10; i++)
+		queue.post (makeEvent (i));
+	QCOMPARE (spy.count (), 0);
+	QTRY_COMPARE (spy.count (), 1);
+	QTest::qWait (20);
+	QCOMPARE (spy.count (), 1);
+	
+	// after a drain, the next post signals again
+	QVector<SourceEvent> batch;
+	QVERIFY (queue.drain (batch, 16));
+	queue.post (makeEvent (10));
+	QTRY_COMPARE (spy.count (), 2);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SourceEventsTest::overflows ()
+{
+	SourceEventQueue queue;
+	for(quint32 i = 0; i < SourceEventQueue::kCapacity; i++)
+		QVERIFY (queue.post (makeEvent (i)));
+	
+	// full, the event is dropped and the consumer is told once
+	QVERIFY (!queue.post (makeEvent (SourceEventQueue::kCapacity)));
+	QVERIFY (queue.takeOverflow ());
+	QVERIFY (!queue.takeOverflow ());
+	
+	// what fit is still there, in order
+	QVector<SourceEvent> batch;
+	QVERIFY (queue.drain (batch, SourceEventQueue::kCapacity + 1));
+	QCOMPARE (batch.count (), int (SourceEventQueue::kCapacity));
+	QCOMPARE (batch.last ().generation, SourceEventQueue::kCapacity - 1);
+	
+	// and there's room again
+	QVERIFY (queue.post (makeEvent (1)));
+	QVERIFY (!queue.takeOverflow ());
+	QVERIFY (queue.drain (batch, 16));
+	QCOMPARE (batch.count (), 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SourceEventsTest::filtersGenerations ()
+{
+	// a source at a reused address gets a new wrapper, the old one's events must not reach it
+	SourceEventQueue queue;
+	queue.post (makeEvent (1));
+	queue.post (makeEvent (2));
+	queue.post (makeEvent (1));
+	
+	QVector<SourceEvent> batch;
+	QVERIFY (queue.drain (batch, 16));
+	int handled = 0;
+	for(const SourceEvent& event : batch)
+		if(event.isFor (fakeSource (0x1000), 2))
+			handled++;
+	QCOMPARE (handled, 1);
+	
+	QVERIFY (!batch[0].isFor (fakeSource (0x2000), 1)); // another source
+	QVERIFY (batch[0].isFor (fakeSource (0x1000), 1));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QTEST_GUILESS_MAIN (SourceEventsTest)
+#include "sourceeventstest.moc"
@@ -0,0 +1,165 @@
+//************************************************************************************************
+//
+// UCOBSControlPlugin
+// Copyright (c)2021 PreSonus Audio Electronics, Inc
+//
+// Filename    : statshistorytest.cpp
+// Created by  : James Inkster, jinkster@presonus.com
+// Description : Unit tests of the StatsHistory
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program. If not, see <https://www.gnu.org/licenses/>
+//************************************************************************************************
+
+
+#include "statshistory.h"
+
+#include <QtTest>
+#include <QDateTime>
+
+//************************************************************************************************
+// StatsHistoryTest
+//************************************************************************************************
+
+class StatsHistoryTest : public QObject
+{
+	Q_OBJECT
+private slots:
+	void stampsMonotonic ();
+	void bucketsRange ();
+	void leavesGaps ();
+	void dropsOldest ();
+	void rejectsEmptyRange ();
+	
+protected:
+	static StatsHistory::Row makeRow (qint64 time, double value);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+StatsHistory::Row StatsHistoryTest::makeRow (qint64 time, double value)
+{
+	StatsHistory::Row row;
+	row.time = time;
+	for(int series = 0; series < StatsHistory::kNumSeries; series++)
+		row.values[series] = value;
+	return row;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StatsHistoryTest::stampsMonotonic ()
+{
+	StatsHistory history;
+	qint64 last = history.now ();
+	for(int i = 0; i < 1000; i++)
+	{
+		qint64 time = history.now ();
+		QVERIFY (time >= last);
+		last = time;
+	}
+	
+	// replies get wall-clock times, derived from the monotonic stamp
+	qint64 wallTime = history.toWallTime (history.now ());
+	QVERIFY (qAbs (wallTime - QDateTime::currentMSecsSinceEpoch ()) < 1000);
+	QVERIFY (qAbs (history.toWallTime (last) - history.toWallTime (last - 500) - 500) <= 5); // both clocks move on between the calls
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StatsHistoryTest::bucketsRange ()
+{
+	StatsHistory history;
+	for(qint64 time = 0; time < 100; time++)
+		history.append (makeRow (time, double (time)));
+	
+	StatsHistory::Range range;
+	quint32 mask = 1u << StatsHistory::kCpuUsage;
+	QVERIFY (history.query (range, 0, 100, 10, mask));
+	QCOMPARE (range.start, qint64 (0));
+	QCOMPARE (range.step, qint64 (10));
+	QCOMPARE (range.counts.count (), 10);
+	for(int bucket = 0; bucket < 10; bucket++)
+	{
+		QCOMPARE (range.counts[bucket], 10);
+		QCOMPARE (range.min[StatsHistory::kCpuUsage][bucket], 10. * bucket);
+		QCOMPARE (range.max[StatsHistory::kCpuUsage][bucket], 10. * bucket + 9);
+		QCOMPARE (range.avg[StatsHistory::kCpuUsage][bucket], 10. * bucket + 4.5);
+	}
+	
+	// only the series asked for are filled in
+	QVERIFY (range.min[StatsHistory::kFps].isEmpty ());
+	QVERIFY (range.avg[StatsHistory::kDroppedFrames].isEmpty ());
+	
+	// a step that doesn't divide the range is rounded up, the last sample still has a bucket
+	QVERIFY (history.query (range, 0, 100, 3, mask));
+	QCOMPARE (range.step, qint64 (34));
+	QCOMPARE (range.counts[0] + range.counts[1] + range.counts[2], 100);
+	QCOMPARE (range.max[StatsHistory::kCpuUsage][2], 99.);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StatsHistoryTest::leavesGaps ()
+{
+	StatsHistory history;
+	history.append (makeRow (5, 1.));
+	history.append (makeRow (35, 3.));
+	
+	StatsHistory::Range range;
+	QVERIFY (history.query (range, 0, 40, 4, 1u << StatsHistory::kFps));
+	QCOMPARE (range.counts, QVector<int> ({1, 0, 0, 1}));
+	QCOMPARE (range.avg[StatsHistory::kFps][0], 1.);
+	QCOMPARE (range.avg[StatsHistory::kFps][3], 3.);
+	
+	// samples outside of [from, to) don't count
+	QVERIFY (history.query (range, 10, 35, 5, 1u << StatsHistory::kFps));
+	QCOMPARE (range.counts, QVector<int> ({0, 0, 0, 0, 0}));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StatsHistoryTest::dropsOldest ()
+{
+	StatsHistory history;
+	const int extra = 10;
+	for(qint64 time = 0; time < StatsHistory::kCapacity + extra; time++)
+		history.append (makeRow (time, double (time)));
+	
+	StatsHistory::Range range;
+	quint32 mask = 1u << StatsHistory::kCpuUsage;
+	QVERIFY (history.query (range, 0, StatsHistory::kCapacity + extra, 1, mask));
+	QCOMPARE (range.counts[0], StatsHistory::kCapacity);
+	QCOMPARE (range.min[StatsHistory::kCpuUsage][0], double (extra));
+	QCOMPARE (range.max[StatsHistory::kCpuUsage][0], double (StatsHistory::kCapacity + extra - 1));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StatsHistoryTest::rejectsEmptyRange ()
+{
+	StatsHistory history;
+	StatsHistory::Range range;
+	QVERIFY (!history.query (range, 100, 100, 10, ~0u));
+	QVERIFY (!history.query (range, 100, 50, 10, ~0u));
+	QVERIFY (!history.query (range, 0, 100, 0, ~0u));
+	
+	// more buckets than allowed are capped
+	QVERIFY (history.query (range, 0, 1000000, StatsHistory::kMaxBuckets * 2, ~0u));
+	QCOMPARE (range.counts.count (), StatsHistory::kMaxBuckets);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+QTEST_GUILESS_MAIN (StatsHistoryTest)
+#include "statshistorytest.moc"